@@ -1,131 +1,1093 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <assert.h>
-#include "array.h"
-
-#define LEFT (0)
-#define RIGHT (1)
-#define CHILDREN (2)
-
-// Binary tree structure for array
-struct array {
-    size_t size;
-    int sum;
-    int (*combine)(int, int);
-    struct array *child[CHILDREN];
-};
-
-
-// // Create a new array holding n values, all initially 0.
-// // Behavior is undefined if n == 0.
-// // Cost: O(n).
-Array *arrayCreate(int (*combine)(int, int), size_t n){
-    if(n == 0){
-        return 0;
-    }
-
-    Array *a = malloc(sizeof(Array));
-    a->size = n;
-    a->combine = combine;
-
-    if (n == 1){
-        // child node
-        a->child[LEFT] = 0;
-        a->child[RIGHT] = 0;
-        a->sum = 0;
-        return a;
-    } else{
-        // recurse for parent nodes
-        a->child[LEFT] = arrayCreate(combine, n/2);
-        a->child[RIGHT] = arrayCreate(combine, n-n/2);
-        a->sum = a->combine(a->child[LEFT]->sum, a->child[RIGHT]->sum);
-    }
-    return a;
-}
-
-
-// // Free all space used by an array.
-// // Cost: O(n).
-void arrayDestroy(Array *a){
-    if(a == 0){
-        return;
-    } else{
-        // recursively destroy
-        arrayDestroy(a->child[LEFT]);
-        arrayDestroy(a->child[RIGHT]);
-        free(a);
-    }
-}
-
-
-// // Return the number of size of an array.
-// // Cost: O(1).
-size_t arraySize(const Array *a){
-    return a->size;
-}
-
-
-// // Return the i-th element of an array
-// // or 0 if i is out of range.
-// // Cost: O(log n).
-int arrayGet(const Array *a, size_t i){
-    if(a == 0 || i >= a->size || i < 0){
-        // out of range
-        return 0;
-    } else if (a->size == 1){
-        // found it
-        return a->sum;
-    } else if(i < a->child[LEFT]->size){
-        // search left subtree
-        return arrayGet(a->child[LEFT], i);
-    } else {
-        // search right subtree
-        return arrayGet(a->child[RIGHT], i-a->child[LEFT]->size);
-    }
-}
-
-
-// // Set the i-th element of an array to v.
-// // No effect if i is out of range.
-// // Cost: O(log n).
-void arraySet(Array *a, size_t i, int v){
-    if(a == 0 || i >= a->size || i < 0){
-        // out of range
-        return;
-    } else if (a->size == 1){
-        // set sum of leaf
-        a->sum = v;
-        return;
-    } else if(i < a->child[LEFT]->size){
-        // recurse and then aggregate sums of leaves
-        arraySet(a->child[LEFT], i, v);
-        a->sum = a->combine(a->child[LEFT]->sum, a->child[RIGHT]->sum);
-    } else {
-        // recurse and then aggregate sums of leaves
-        arraySet(a->child[RIGHT], i-a->child[LEFT]->size, v);
-        a->sum = a->combine(a->child[LEFT]->sum, a->child[RIGHT]->sum);
-    }
-}
-
-
-// Return the result of aggregating the first k size
-// of an array in order using the combine combine.
-// If k is zero or greater than size, returns combination of all size.
-// Cost: O(log n).
-int arrayCombine(const Array *a, size_t k){
-    if (a == 0){
-        // empty input array
-        return 0;
-    } else if(k >= a->size || k == 0){
-        // return found sum
-        return a->sum;
-    } else if(k <= a->child[LEFT]->size){
-        // traverse left subtree
-        return arrayCombine(a->child[LEFT], k);
-    } else if(k > a->child[LEFT]->size){
-        // combine sums of left and the result of the recursive call on right
-        return a->combine(a->child[LEFT]->sum, arrayCombine(a->child[RIGHT], k - a->child[LEFT]->size));
-    } else {
-        return a->sum;
-    }
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "array.h"
+
+// Implicit binary tree structure for array.
+// Nodes live in one flat array in heap order: node 1 is the root and
+// node p has children 2p and 2p+1.  The n elements are the leaves
+// sum[leaves .. leaves+n), where leaves is n rounded up to a power of
+// two; the padding leaves past n stay 0 and are never reported.
+// No per-node pointers, and every operation is a loop, not a recursion.
+//
+// Arrays made by arrayCreateInvertible instead keep a Fenwick tree in
+// sum[1 .. n], where sum[j] aggregates the j & -j elements ending at j.
+// That takes n words rather than 2 * leaves, and is selected by a
+// nonzero inverse.
+//
+// Range updates from arrayApplyRange are lazy: an internal node p with
+// tagged[p] set has had tag[p] applied to its own sum but not yet to its
+// children's.  Both arrays are allocated on the first range update.
+//
+// Arrays made by arrayCreatePersistent are instead a tree of separately
+// allocated, reference-counted nodes under root.  Updates copy the path
+// they change, so every snapshot keeps seeing its own version while it
+// shares all untouched nodes with the others.
+//
+// Arrays made by arrayCreateConcurrent are flat trees guarded by a
+// sequence lock: writers serialize on writer and make seq odd while they
+// work, and readers take no lock but retry if seq was odd or changed
+// under them.  Both sides access sum through atomics.
+struct array {
+    size_t size;
+    size_t leaves;
+    int (*combine)(int, int);
+    int (*inverse)(int, int);
+    int *sum;
+    int *tag;
+    unsigned char *tagged;
+    int (*apply)(int, int, size_t);
+    int (*compose)(int, int);
+    struct arrayNode *root;
+    int concurrent;
+    atomic_size_t seq;
+    pthread_mutex_t writer;
+};
+
+// node of a persistent array; refs counts the parents and handles
+// pointing at it, and leaves have no children
+struct arrayNode {
+    atomic_size_t refs;
+    int sum;
+    struct arrayNode *child[2];
+};
+
+// deepest stack combineRangeLazy can need: two partial nodes per level
+#define MAX_DEPTH (2 * 8 * sizeof(size_t) + 2)
+
+
+// Allocate the header of an array of n > 0 elements, with leaves set to
+// n rounded up to a power of two and every mode field cleared, so the
+// constructors only set what their backend needs.
+static Array *arrayAlloc(int (*combine)(int, int), size_t n){
+    Array *a = malloc(sizeof(Array));
+    assert(a);
+    a->size = n;
+    a->combine = combine;
+    a->inverse = 0;
+    a->sum = 0;
+    a->tag = 0;
+    a->tagged = 0;
+    a->apply = 0;
+    a->compose = 0;
+    a->root = 0;
+    a->concurrent = 0;
+    a->leaves = 1;
+    while(a->leaves < n){
+        a->leaves *= 2;
+    }
+    return a;
+}
+
+
+// // Create a new array holding n values, all initially 0.
+// // Behavior is undefined if n == 0.
+// // Cost: O(n).
+Array *arrayCreate(int (*combine)(int, int), size_t n){
+    if(n == 0){
+        return 0;
+    }
+
+    Array *a = arrayAlloc(combine, n);
+    a->sum = calloc(2 * a->leaves, sizeof(int));
+    assert(a->sum);
+
+    // aggregate parent nodes bottom-up
+    for(size_t p = a->leaves - 1; p >= 1; p--){
+        a->sum[p] = combine(a->sum[2*p], a->sum[2*p+1]);
+    }
+    return a;
+}
+
+
+// Threads used by arrayCreateFrom; see arraySetThreads
+static int arrayThreads = 1;
+
+// arrays with fewer elements than this are always built on one thread
+#define PARALLEL_THRESHOLD ((size_t) 1 << 16)
+
+// arraySetThreads clamps to this, which bounds the per-thread arrays
+// arrayCreateFrom keeps on the stack
+#define MAX_THREADS (256)
+
+
+// Set how many threads arrayCreateFrom may use.  Arrays smaller than
+// PARALLEL_THRESHOLD elements are built on one thread regardless.
+// The result does not depend on the thread count.  Default 1; at most
+// MAX_THREADS.
+void arraySetThreads(int threads){
+    arrayThreads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+
+// one thread's share of arrayCreateFrom: the subtree under node root,
+// whose leaves sit depth levels below it
+typedef struct arrayBuildTask {
+    Array *a;
+    const int *values;
+    size_t root;
+    size_t depth;
+} ArrayBuildTask;
+
+
+// Fill the leaves under task->root from values, padding past the end
+// with 0, then aggregate the subtree one level at a time from the bottom.
+static void *arrayBuildSubtree(void *arg){
+    ArrayBuildTask *task = arg;
+    Array *a = task->a;
+    size_t width = (size_t) 1 << task->depth;
+    size_t first = task->root << task->depth;
+    size_t start = first - a->leaves;
+
+    size_t copied = start >= a->size ? 0 : a->size - start < width ? a->size - start : width;
+    memcpy(a->sum + first, task->values + start, copied * sizeof(int));
+    memset(a->sum + first + copied, 0, (width - copied) * sizeof(int));
+
+    for(width /= 2, first /= 2; width >= 1; width /= 2, first /= 2){
+        for(size_t p = first; p < first + width; p++){
+            a->sum[p] = a->combine(a->sum[2*p], a->sum[2*p+1]);
+        }
+    }
+    return 0;
+}
+
+
+// Create a new array holding a copy of values[0 .. n).
+// Builds the tree bottom-up in one pass, so it costs O(n) rather than
+// the O(n log n) of n calls to arraySet; with arraySetThreads above 1,
+// disjoint subtrees are built on separate threads.
+// Returns 0 if n == 0.
+Array *arrayCreateFrom(int (*combine)(int, int), const int *values, size_t n){
+    if(n == 0){
+        return 0;
+    }
+
+    Array *a = arrayAlloc(combine, n);
+    a->sum = malloc(2 * a->leaves * sizeof(int));
+    assert(a->sum);
+
+    // one subtree per thread: the nodes [parts, 2 * parts)
+    size_t parts = 1;
+    if(n >= PARALLEL_THRESHOLD){
+        while(2 * parts <= (size_t) arrayThreads && 2 * parts <= a->leaves){
+            parts *= 2;
+        }
+    }
+    size_t depth = 0;
+    while((parts << depth) < a->leaves){
+        depth++;
+    }
+
+    ArrayBuildTask tasks[parts];
+    pthread_t threads[parts];
+    size_t started = 1;
+    for(size_t t = 0; t < parts; t++){
+        tasks[t] = (ArrayBuildTask) { a, values, parts + t, depth };
+    }
+    for(; started < parts; started++){
+        if(pthread_create(&threads[started], 0, arrayBuildSubtree, &tasks[started]) != 0){
+            break;
+        }
+    }
+    arrayBuildSubtree(&tasks[0]);
+    for(size_t t = started; t < parts; t++){
+        // thread creation failed; build the rest here
+        arrayBuildSubtree(&tasks[t]);
+    }
+    for(size_t t = 1; t < started; t++){
+        pthread_join(threads[t], 0);
+    }
+
+    // the few nodes above the subtrees
+    for(size_t p = parts - 1; p >= 1; p--){
+        a->sum[p] = combine(a->sum[2*p], a->sum[2*p+1]);
+    }
+    return a;
+}
+
+
+// Create a new array holding n values, all initially 0, backed by a
+// Fenwick tree.  combine must be associative and commutative with 0 as
+// its identity, and inverse(a, b) must return the d for which
+// combine(b, d) == a; for example a - b for +, or a ^ b for ^.
+// arraySet and arrayCombine cost O(log n) with n words of memory;
+// arrayGet is O(log n) rather than O(1).
+// Returns 0 if n == 0.
+Array *arrayCreateInvertible(int (*combine)(int, int), int (*inverse)(int, int), size_t n){
+    if(n == 0){
+        return 0;
+    }
+
+    Array *a = arrayAlloc(combine, n);
+    a->inverse = inverse;
+    a->sum = calloc(n + 1, sizeof(int));
+    assert(a->sum);
+    return a;
+}
+
+
+// Aggregate the first k elements of a Fenwick-backed array.
+static int fenwickPrefix(const Array *a, size_t k){
+    int total = 0;
+
+    for(size_t j = k; j > 0; j -= j & -j){
+        total = a->combine(a->sum[j], total);
+    }
+    return total;
+}
+
+
+// Drop one reference to node, freeing it and whatever only it kept alive.
+static void nodeRelease(struct arrayNode *node){
+    struct arrayNode *stack[MAX_DEPTH];
+    size_t top = 0;
+
+    stack[top++] = node;
+    while(top > 0){
+        node = stack[--top];
+        if(atomic_fetch_sub(&node->refs, 1) == 1){
+            if(node->child[0]){
+                stack[top++] = node->child[0];
+                stack[top++] = node->child[1];
+            }
+            free(node);
+        }
+    }
+}
+
+
+// Create a new array holding n values, all initially 0, as a persistent
+// tree: arraySet copies the O(log n) nodes on the path it changes
+// instead of overwriting them, so snapshots taken by arraySnapshot stay
+// unchanged.  All other operations work as usual; arrayGet, arraySet and
+// arrayCombine cost O(log n).
+// Returns 0 if n == 0.
+Array *arrayCreatePersistent(int (*combine)(int, int), size_t n){
+    if(n == 0){
+        return 0;
+    }
+
+    Array *a = arrayAlloc(combine, n);
+
+    // all-zero subtrees of equal height are equal, so share one per level
+    a->root = malloc(sizeof(struct arrayNode));
+    assert(a->root);
+    atomic_init(&a->root->refs, 1);
+    a->root->sum = 0;
+    a->root->child[0] = a->root->child[1] = 0;
+    for(size_t width = 1; width < a->leaves; width *= 2){
+        struct arrayNode *parent = malloc(sizeof(struct arrayNode));
+        assert(parent);
+        atomic_init(&parent->refs, 1);
+        atomic_store(&a->root->refs, 2);
+        parent->sum = combine(a->root->sum, a->root->sum);
+        parent->child[0] = parent->child[1] = a->root;
+        a->root = parent;
+    }
+    return a;
+}
+
+
+// Return a new handle to the current version of a persistent array, in
+// O(1).  It is unaffected by later updates through either handle and is
+// released with arrayDestroy.  Different handles may be used from
+// different threads at once, since they share only nodes that are never
+// written again.
+// Returns 0 unless a was made by arrayCreatePersistent.
+Array *arraySnapshot(const Array *a){
+    if(a == 0 || a->root == 0){
+        return 0;
+    }
+
+    Array *copy = malloc(sizeof(Array));
+    assert(copy);
+    *copy = *a;
+    atomic_fetch_add(&copy->root->refs, 1);
+    return copy;
+}
+
+
+// Read element i of a persistent array.
+static int persistentGet(const Array *a, size_t i){
+    const struct arrayNode *node = a->root;
+    for(size_t bit = a->leaves / 2; bit >= 1; bit /= 2){
+        node = node->child[(i & bit) != 0];
+    }
+    return node->sum;
+}
+
+
+// Set element i of a persistent array to v.  Nodes referenced from
+// nowhere else are updated in place; the first shared node on the way
+// down, and so everything below it, is copied.
+static void persistentSet(Array *a, size_t i, int v){
+    struct arrayNode *path[MAX_DEPTH];
+    struct arrayNode **slot = &a->root;
+    size_t depth = 0;
+
+    for(size_t bit = a->leaves; ; bit /= 2){
+        struct arrayNode *node = *slot;
+        if(atomic_load(&node->refs) != 1){
+            struct arrayNode *copy = malloc(sizeof(struct arrayNode));
+            assert(copy);
+            atomic_init(&copy->refs, 1);
+            copy->sum = node->sum;
+            copy->child[0] = node->child[0];
+            copy->child[1] = node->child[1];
+            if(copy->child[0]){
+                atomic_fetch_add(&copy->child[0]->refs, 1);
+                atomic_fetch_add(&copy->child[1]->refs, 1);
+            }
+            nodeRelease(node);
+            *slot = node = copy;
+        }
+        path[depth++] = node;
+        if(bit == 1){
+            break;
+        }
+        slot = &node->child[(i & (bit / 2)) != 0];
+    }
+
+    // set the leaf, then re-aggregate each ancestor on the way up
+    path[--depth]->sum = v;
+    while(depth-- > 0){
+        path[depth]->sum = a->combine(path[depth]->child[0]->sum, path[depth]->child[1]->sum);
+    }
+}
+
+
+// Aggregate elements [lo, hi) of a persistent array in order, walking
+// down from the root with an explicit stack.
+static int combineRangeNodes(const Array *a, size_t lo, size_t hi){
+    struct { const struct arrayNode *node; size_t start; size_t count; } stack[MAX_DEPTH];
+    size_t top = 0;
+    int total = 0;
+    int haveTotal = 0;
+
+    stack[top].node = a->root;
+    stack[top].start = 0;
+    stack[top].count = a->leaves;
+    top++;
+
+    while(top > 0){
+        top--;
+        const struct arrayNode *node = stack[top].node;
+        size_t start = stack[top].start;
+        size_t count = stack[top].count;
+
+        if(start >= hi || start + count <= lo){
+            continue;
+        } else if(lo <= start && start + count <= hi){
+            total = haveTotal ? a->combine(total, node->sum) : node->sum;
+            haveTotal = 1;
+            continue;
+        }
+
+        // right child first, so the left one is popped first
+        for(size_t child = 2; child-- > 0;){
+            stack[top].node = node->child[child];
+            stack[top].start = start + child * (count / 2);
+            stack[top].count = count / 2;
+            top++;
+        }
+    }
+    return total;
+}
+
+
+// Create a new array holding n values, all initially 0, that may be
+// used from many threads at once.  arrayGet, arrayCombine and
+// arrayCombineRange take no lock: they read the tree optimistically and
+// retry if a writer got in the way, so readers never block each other
+// and only wait out writes that overlap them.  arraySet and the other
+// updates are serialized among themselves, and readers see each
+// arraySetMany or arrayApplyRange either not at all or in full.
+// Costs are as for arrayCreate.
+// Returns 0 if n == 0.
+Array *arrayCreateConcurrent(int (*combine)(int, int), size_t n){
+    Array *a = arrayCreate(combine, n);
+    if(a){
+        a->concurrent = 1;
+        atomic_init(&a->seq, 0);
+        int error = pthread_mutex_init(&a->writer, 0);
+        assert(error == 0);
+        (void) error;
+    }
+    return a;
+}
+
+
+// Start a write section on a concurrent array: take writer and make seq
+// odd, so readers retry until concurrentEnd.
+static void concurrentBegin(Array *a){
+    pthread_mutex_lock(&a->writer);
+    size_t seq = atomic_load_explicit(&a->seq, memory_order_relaxed);
+    atomic_store_explicit(&a->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+
+static void concurrentEnd(Array *a){
+    size_t seq = atomic_load_explicit(&a->seq, memory_order_relaxed);
+    atomic_store_explicit(&a->seq, seq + 1, memory_order_release);
+    pthread_mutex_unlock(&a->writer);
+}
+
+
+// Set element i to v and recombine its ancestors, inside a write section.
+static void concurrentStore(Array *a, size_t i, int v){
+    // only writers store to sum, and they hold writer, so plain loads are safe
+    size_t p = a->leaves + i;
+    __atomic_store_n(&a->sum[p], v, __ATOMIC_RELAXED);
+    for(p /= 2; p >= 1; p /= 2){
+        __atomic_store_n(&a->sum[p], a->combine(a->sum[2*p], a->sum[2*p+1]), __ATOMIC_RELAXED);
+    }
+}
+
+
+// Set element i of a concurrent array to v, as one write section.
+static void concurrentSet(Array *a, size_t i, int v){
+    concurrentBegin(a);
+    concurrentStore(a, i, v);
+    concurrentEnd(a);
+}
+
+
+// combineRange for a concurrent array: repeat the walk until it ran
+// entirely between two writes.
+static int combineRangeConcurrent(const Array *a, size_t lo, size_t hi){
+    for(;;){
+        size_t seq = atomic_load_explicit(&a->seq, memory_order_acquire);
+        if(seq & 1){
+            // a writer is mid-update; let it finish if it shares our core
+            sched_yield();
+            continue;
+        }
+
+        int left = 0;
+        int right = 0;
+        int haveLeft = 0;
+        int haveRight = 0;
+        for(size_t l = a->leaves + lo, r = a->leaves + hi; l < r; l /= 2, r /= 2){
+            if(l & 1){
+                int value = __atomic_load_n(&a->sum[l], __ATOMIC_RELAXED);
+                left = haveLeft ? a->combine(left, value) : value;
+                haveLeft = 1;
+                l++;
+            }
+            if(r & 1){
+                r--;
+                int value = __atomic_load_n(&a->sum[r], __ATOMIC_RELAXED);
+                right = haveRight ? a->combine(value, right) : value;
+                haveRight = 1;
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&a->seq, memory_order_relaxed) == seq){
+            if(haveLeft && haveRight){
+                return a->combine(left, right);
+            }
+            return haveLeft ? left : right;
+        }
+    }
+}
+
+
+// arraySearchPrefix for a concurrent array: the same descent, repeated
+// until it ran entirely between two writes.  Whether any prefix reaches
+// target is decided at the leaf the descent ends on, in the same read.
+static size_t searchPrefixConcurrent(const Array *a, int target){
+    for(;;){
+        size_t seq = atomic_load_explicit(&a->seq, memory_order_acquire);
+        if(seq & 1){
+            sched_yield();
+            continue;
+        }
+
+        size_t p = 1;
+        size_t start = 0;
+        int total = 0;
+        int haveTotal = 0;
+        for(size_t half = a->leaves / 2; half >= 1; half /= 2){
+            int left = __atomic_load_n(&a->sum[2*p], __ATOMIC_RELAXED);
+            int next = haveTotal ? a->combine(total, left) : left;
+            if(start + half >= a->size || next >= target){
+                p = 2*p;
+            } else {
+                total = next;
+                haveTotal = 1;
+                start += half;
+                p = 2*p + 1;
+            }
+        }
+        int leaf = __atomic_load_n(&a->sum[p], __ATOMIC_RELAXED);
+        int prefix = haveTotal ? a->combine(total, leaf) : leaf;
+
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&a->seq, memory_order_relaxed) == seq){
+            return prefix >= target ? start + 1 : 0;
+        }
+    }
+}
+
+
+// Apply an update to node p, which covers count leaves, and leave it
+// pending for p's children.
+static void applyNode(Array *a, size_t p, int tag, size_t count){
+    a->sum[p] = a->apply(tag, a->sum[p], count);
+    if(p < a->leaves){
+        a->tag[p] = a->tagged[p] ? a->compose(tag, a->tag[p]) : tag;
+        a->tagged[p] = 1;
+    }
+}
+
+
+// Hand node p's pending update, if any, down to its children.
+static void pushNode(Array *a, size_t p, size_t count){
+    if(a->tagged && a->tagged[p]){
+        applyNode(a, 2*p, a->tag[p], count / 2);
+        applyNode(a, 2*p+1, a->tag[p], count / 2);
+        a->tagged[p] = 0;
+    }
+}
+
+
+// Push pending updates down every ancestor of leaf node p, root first.
+static void pushPath(Array *a, size_t p){
+    size_t height = 0;
+    while(((size_t) 1 << height) < a->leaves){
+        height++;
+    }
+    // the ancestor that many levels up covers 2^height leaves
+    for(; height > 0; height--){
+        pushNode(a, p >> height, (size_t) 1 << height);
+    }
+}
+
+
+// Re-aggregate every ancestor of leaf node p, keeping their pending updates.
+static void rebuildPath(Array *a, size_t p){
+    for(size_t count = 2; p > 1; count *= 2){
+        p /= 2;
+        a->sum[p] = a->combine(a->sum[2*p], a->sum[2*p+1]);
+        if(a->tagged && a->tagged[p]){
+            a->sum[p] = a->apply(a->tag[p], a->sum[p], count);
+        }
+    }
+}
+
+
+// // Free all space used by an array.
+// // Cost: O(n).
+void arrayDestroy(Array *a){
+    if(a == 0){
+        return;
+    } else{
+        if(a->root){
+            nodeRelease(a->root);
+        }
+        if(a->concurrent){
+            pthread_mutex_destroy(&a->writer);
+        }
+        free(a->sum);
+        free(a->tag);
+        free(a->tagged);
+        free(a);
+    }
+}
+
+
+// // Return the number of size of an array.
+// // Cost: O(1).
+size_t arraySize(const Array *a){
+    return a->size;
+}
+
+
+// // Return the i-th element of an array
+// // or 0 if i is out of range.
+// // Cost: O(1) for plain and concurrent arrays; O(log n) for Fenwick
+// // and persistent arrays, and once arrayApplyRange has been used.
+int arrayGet(const Array *a, size_t i){
+    if(a == 0 || i >= a->size){
+        // out of range
+        return 0;
+    } else if(a->inverse){
+        // strip the first i elements off the first i+1
+        return a->inverse(fenwickPrefix(a, i + 1), fenwickPrefix(a, i));
+    } else if(a->concurrent){
+        return __atomic_load_n(&a->sum[a->leaves + i], __ATOMIC_RELAXED);
+    } else if(a->root){
+        return persistentGet(a, i);
+    } else if(a->tagged){
+        // pending updates above the leaf apply to it, nearest (oldest) first
+        size_t p = a->leaves + i;
+        int value = a->sum[p];
+        for(p /= 2; p >= 1; p /= 2){
+            if(a->tagged[p]){
+                value = a->apply(a->tag[p], value, 1);
+            }
+        }
+        return value;
+    } else {
+        return a->sum[a->leaves + i];
+    }
+}
+
+
+// // Set the i-th element of an array to v.
+// // No effect if i is out of range.
+// // Cost: O(log n).
+void arraySet(Array *a, size_t i, int v){
+    if(a == 0 || i >= a->size){
+        // out of range
+        return;
+    } else if(a->root){
+        persistentSet(a, i, v);
+        return;
+    } else if(a->concurrent){
+        concurrentSet(a, i, v);
+        return;
+    } else if(a->inverse){
+        // fold the change into every Fenwick node covering i
+        int delta = a->inverse(v, arrayGet(a, i));
+        for(size_t j = i + 1; j <= a->size; j += j & -j){
+            a->sum[j] = a->combine(a->sum[j], delta);
+        }
+        return;
+    }
+
+    // set the leaf, then re-aggregate each ancestor on the way up
+    size_t p = a->leaves + i;
+    if(a->tagged){
+        pushPath(a, p);
+        a->sum[p] = v;
+        rebuildPath(a, p);
+        return;
+    }
+    a->sum[p] = v;
+    for(p /= 2; p >= 1; p /= 2){
+        a->sum[p] = a->combine(a->sum[2*p], a->sum[2*p+1]);
+    }
+}
+
+
+// Aggregate elements [lo, hi) in order, where lo < hi <= size.
+// Climbs from both ends at once, taking a node whenever it lies wholly
+// inside the range; left pieces are combined on the right of what has
+// been gathered so far and right pieces on the left, so combine need
+// not be commutative.
+static int combineRange(const Array *a, size_t lo, size_t hi){
+    int left = 0;
+    int right = 0;
+    int haveLeft = 0;
+    int haveRight = 0;
+
+    for(size_t l = a->leaves + lo, r = a->leaves + hi; l < r; l /= 2, r /= 2){
+        if(l & 1){
+            left = haveLeft ? a->combine(left, a->sum[l]) : a->sum[l];
+            haveLeft = 1;
+            l++;
+        }
+        if(r & 1){
+            r--;
+            right = haveRight ? a->combine(a->sum[r], right) : a->sum[r];
+            haveRight = 1;
+        }
+    }
+
+    if(haveLeft && haveRight){
+        return a->combine(left, right);
+    }
+    return haveLeft ? left : right;
+}
+
+
+// Aggregate elements [lo, hi) in order while range updates are pending.
+// Walks down from the root without modifying the tree, carrying the
+// composition of the pending updates above each node and applying it to
+// the nodes that lie wholly inside the range.
+static int combineRangeLazy(const Array *a, size_t lo, size_t hi){
+    struct { size_t node; size_t start; size_t count; int tag; int tagged; } stack[MAX_DEPTH];
+    size_t top = 0;
+    int total = 0;
+    int haveTotal = 0;
+
+    stack[top].node = 1;
+    stack[top].start = 0;
+    stack[top].count = a->leaves;
+    stack[top].tagged = 0;
+    top++;
+
+    while(top > 0){
+        top--;
+        size_t p = stack[top].node;
+        size_t start = stack[top].start;
+        size_t count = stack[top].count;
+        int tag = stack[top].tag;
+        int tagged = stack[top].tagged;
+
+        if(start >= hi || start + count <= lo){
+            // disjoint
+            continue;
+        } else if(lo <= start && start + count <= hi){
+            // wholly inside: take it, with the updates from above applied
+            int value = tagged ? a->apply(tag, a->sum[p], count) : a->sum[p];
+            total = haveTotal ? a->combine(total, value) : value;
+            haveTotal = 1;
+            continue;
+        }
+
+        // partly inside: this node's own pending update is older than the
+        // ones inherited from above
+        if(a->tagged[p]){
+            tag = tagged ? a->compose(tag, a->tag[p]) : a->tag[p];
+            tagged = 1;
+        }
+        // right child first, so the left one is popped first
+        for(size_t child = 2; child-- > 0;){
+            stack[top].node = 2*p + child;
+            stack[top].start = start + child * (count / 2);
+            stack[top].count = count / 2;
+            stack[top].tag = tag;
+            stack[top].tagged = tagged;
+            top++;
+        }
+    }
+    return total;
+}
+
+
+// Return the result of aggregating elements lo through hi-1 in order.
+// hi is clamped to the size; returns 0 if the range is empty.
+// Cost: O(log n).
+int arrayCombineRange(const Array *a, size_t lo, size_t hi){
+    if(a == 0){
+        return 0;
+    }
+    if(hi > a->size){
+        hi = a->size;
+    }
+    if(lo >= hi){
+        return 0;
+    }
+
+    if(a->inverse){
+        return a->inverse(fenwickPrefix(a, hi), fenwickPrefix(a, lo));
+    } else if(a->concurrent){
+        return combineRangeConcurrent(a, lo, hi);
+    } else if(a->root){
+        return combineRangeNodes(a, lo, hi);
+    } else if(a->tagged){
+        return combineRangeLazy(a, lo, hi);
+    } else {
+        return combineRange(a, lo, hi);
+    }
+}
+
+
+// Apply an update to elements lo through hi-1; hi is clamped to the size.
+// The update is described by tag and two functions:
+//   apply(tag, sum, count) returns the aggregate of count consecutive
+//     elements after the update, given their aggregate sum before it;
+//   compose(newer, older) returns the one tag that does the same as
+//     applying older and then newer.
+// apply must distribute over combine, e.g. for range add under +,
+// apply = sum + tag * count and compose = newer + older; under max,
+// apply = sum + tag.  Updates are pushed down lazily, so this costs
+// O(log n); pending updates of a different apply/compose pair are
+// pushed all the way down first, which costs O(n).
+// Fenwick-backed, persistent and concurrent arrays are updated one
+// element at a time, O((hi - lo) log n); on a concurrent array the whole
+// range is one write section, so no other update interleaves with it.
+void arrayApplyRange(Array *a, size_t lo, size_t hi, int tag,
+                     int (*apply)(int, int, size_t), int (*compose)(int, int)){
+    if(a == 0){
+        return;
+    }
+    if(hi > a->size){
+        hi = a->size;
+    }
+    if(lo >= hi){
+        return;
+    }
+
+    if(a->concurrent){
+        concurrentBegin(a);
+        for(size_t i = lo; i < hi; i++){
+            concurrentStore(a, i, apply(tag, a->sum[a->leaves + i], 1));
+        }
+        concurrentEnd(a);
+        return;
+    } else if(a->inverse || a->root){
+        for(size_t i = lo; i < hi; i++){
+            arraySet(a, i, apply(tag, arrayGet(a, i), 1));
+        }
+        return;
+    }
+
+    if(a->tagged == 0){
+        a->tag = malloc(a->leaves * sizeof(int));
+        a->tagged = calloc(a->leaves, sizeof(unsigned char));
+        assert(a->tag && a->tagged);
+    } else if(a->apply != apply || a->compose != compose){
+        // flush the old kind of update to the leaves, top level first
+        for(size_t p = 1, count = a->leaves; p < a->leaves; p++){
+            if(p > 1 && (p & (p - 1)) == 0){
+                count /= 2;
+            }
+            pushNode(a, p, count);
+        }
+    }
+    a->apply = apply;
+    a->compose = compose;
+
+    // clear pending updates above both ends, tag the nodes covering the
+    // range, then re-aggregate above both ends
+    size_t first = a->leaves + lo;
+    size_t last = a->leaves + hi - 1;
+    pushPath(a, first);
+    pushPath(a, last);
+    for(size_t l = first, r = last + 1, count = 1; l < r; l /= 2, r /= 2, count *= 2){
+        if(l & 1){
+            applyNode(a, l++, tag, count);
+        }
+        if(r & 1){
+            applyNode(a, --r, tag, count);
+        }
+    }
+    rebuildPath(a, first);
+    rebuildPath(a, last);
+}
+
+
+// Return the result of aggregating the first k size
+// of an array in order using the combine combine.
+// If k is zero or greater than size, returns combination of all size.
+// Cost: O(log n).
+int arrayCombine(const Array *a, size_t k){
+    if (a == 0){
+        // empty input array
+        return 0;
+    } else if(k >= a->size || k == 0){
+        // all elements; the root also covers the padding, so aggregate the range
+        k = a->size;
+    }
+
+    if(a->inverse){
+        return fenwickPrefix(a, k);
+    } else if(a->concurrent){
+        return combineRangeConcurrent(a, 0, k);
+    } else if(a->root){
+        return combineRangeNodes(a, 0, k);
+    } else if(a->tagged){
+        return combineRangeLazy(a, 0, k);
+    } else {
+        return combineRange(a, 0, k);
+    }
+}
+
+
+// arraySetMany and arrayCombineMany switch to one sequential pass over
+// the tree once a batch covers at least 1/FULL_PASS_RATIO of the leaves
+#define FULL_PASS_RATIO (32)
+
+// qsort comparison for node indices
+static int compareIndex(const void *x, const void *y){
+    size_t i = *(const size_t *) x;
+    size_t j = *(const size_t *) y;
+    return (i > j) - (i < j);
+}
+
+
+// Set element idx[j] to vals[j] for each j < k, in order, so a later
+// entry for the same index wins.  Out-of-range indices are skipped.
+// Instead of walking to the root once per entry, the touched nodes are
+// gathered one level at a time, sorted and deduplicated, so an ancestor
+// shared by many entries is recombined only once.
+// Batches touching a large share of the leaves rebuild the whole tree
+// in one sequential pass instead.
+// Cost: O(k log k + number of distinct ancestors), at most O(n + k).
+void arraySetMany(Array *a, const size_t *idx, const int *vals, size_t k){
+    if(a == 0 || k == 0){
+        return;
+    } else if(a->concurrent){
+        // one write section, so readers see all of the batch or none
+        concurrentBegin(a);
+        for(size_t j = 0; j < k; j++){
+            if(idx[j] < a->size){
+                concurrentStore(a, idx[j], vals[j]);
+            }
+        }
+        concurrentEnd(a);
+        return;
+    } else if(a->inverse || a->root){
+        for(size_t j = 0; j < k; j++){
+            arraySet(a, idx[j], vals[j]);
+        }
+        return;
+    }
+
+    size_t *nodes = malloc(k * sizeof(size_t));
+    assert(nodes);
+
+    // set the leaves, clearing pending updates above them first
+    size_t m = 0;
+    for(size_t j = 0; j < k; j++){
+        if(idx[j] < a->size){
+            size_t p = a->leaves + idx[j];
+            if(a->tagged){
+                pushPath(a, p);
+            }
+            a->sum[p] = vals[j];
+            nodes[m++] = p;
+        }
+    }
+
+    if(m >= a->leaves / FULL_PASS_RATIO){
+        // the walks would reach most of the tree in random order anyway;
+        // one sequential pass over it, level by level, is far cheaper
+        for(size_t first = a->leaves / 2, count = 2; first >= 1; first /= 2, count *= 2){
+            for(size_t p = first; p < 2 * first; p++){
+                a->sum[p] = a->combine(a->sum[2*p], a->sum[2*p+1]);
+                if(a->tagged && a->tagged[p]){
+                    a->sum[p] = a->apply(a->tag[p], a->sum[p], count);
+                }
+            }
+        }
+        free(nodes);
+        return;
+    }
+
+    // parents of a sorted level are sorted, so only the leaves need sorting
+    qsort(nodes, m, sizeof(size_t), compareIndex);
+    for(size_t count = 2; m > 0 && nodes[0] > 1; count *= 2){
+        size_t parents = 0;
+        for(size_t j = 0; j < m; j++){
+            size_t p = nodes[j] / 2;
+            if(parents == 0 || nodes[parents - 1] != p){
+                a->sum[p] = a->combine(a->sum[2*p], a->sum[2*p+1]);
+                if(a->tagged && a->tagged[p]){
+                    a->sum[p] = a->apply(a->tag[p], a->sum[p], count);
+                }
+                nodes[parents++] = p;
+            }
+        }
+        m = parents;
+    }
+
+    free(nodes);
+}
+
+
+// Set out[j] = arrayCombine(a, ks[j]) for each j < k.
+// A batch large enough to touch a good share of the leaves is answered
+// from one left-to-right fold over the leaves instead of k walks.
+// Cost: O(min(k log n, n + k)).
+void arrayCombineMany(const Array *a, const size_t *ks, int *out, size_t k){
+    if(a == 0 || a->inverse || a->root || a->concurrent || a->tagged || k < a->leaves / FULL_PASS_RATIO){
+        for(size_t j = 0; j < k; j++){
+            out[j] = arrayCombine(a, ks[j]);
+        }
+        return;
+    }
+
+    // prefix[i] aggregates the first i + 1 elements
+    const int *leaf = a->sum + a->leaves;
+    int *prefix = malloc(a->size * sizeof(int));
+    assert(prefix);
+    prefix[0] = leaf[0];
+    for(size_t i = 1; i < a->size; i++){
+        prefix[i] = a->combine(prefix[i - 1], leaf[i]);
+    }
+
+    for(size_t j = 0; j < k; j++){
+        size_t kj = ks[j];
+        if(kj >= a->size || kj == 0){
+            kj = a->size;
+        }
+        out[j] = prefix[kj - 1];
+    }
+    free(prefix);
+}
+
+
+// Return the smallest k >= 1 for which arrayCombine(a, k) >= target, or
+// 0 if even all of the elements fall short.  combine must be monotone,
+// so that a prefix never shrinks as it grows: + over non-negative
+// values, or max.  Instead of a binary search over arrayCombine, this
+// descends the tree once, going left whenever the prefix through the
+// left child already reaches target.
+// Cost: O(log n).
+size_t arraySearchPrefix(const Array *a, int target){
+    if(a == 0){
+        return 0;
+    } else if(a->concurrent){
+        return searchPrefixConcurrent(a, target);
+    } else if(arrayCombine(a, a->size) < target){
+        return 0;
+    }
+
+    int total = 0;
+    int haveTotal = 0;
+
+    if(a->inverse){
+        // Fenwick: take the largest blocks that keep the prefix below target
+        size_t step = 1;
+        while(2 * step <= a->size){
+            step *= 2;
+        }
+        size_t k = 0;
+        for(; step >= 1; step /= 2){
+            if(k + step <= a->size){
+                int next = haveTotal ? a->combine(total, a->sum[k + step]) : a->sum[k + step];
+                if(next < target){
+                    total = next;
+                    haveTotal = 1;
+                    k += step;
+                }
+            }
+        }
+        return k + 1;
+    }
+
+    // nodes here are either flat indices or persistent nodes; a child that
+    // reaches the last element is always entered, since everything to its
+    // right is padding
+    size_t p = 1;
+    const struct arrayNode *node = a->root;
+    size_t start = 0;
+    int tag = 0;
+    int tagged = 0;
+    for(size_t half = a->leaves / 2; half >= 1; half /= 2){
+        int left;
+        if(node){
+            left = node->child[0]->sum;
+        } else {
+            // pending updates above the left child apply to it, older first
+            if(a->tagged && a->tagged[p]){
+                tag = tagged ? a->compose(tag, a->tag[p]) : a->tag[p];
+                tagged = 1;
+            }
+            left = tagged ? a->apply(tag, a->sum[2*p], half) : a->sum[2*p];
+        }
+        int next = haveTotal ? a->combine(total, left) : left;
+
+        if(start + half >= a->size || next >= target){
+            p = 2*p;
+            node = node ? node->child[0] : 0;
+        } else {
+            total = next;
+            haveTotal = 1;
+            start += half;
+            p = 2*p + 1;
+            node = node ? node->child[1] : 0;
+        }
+    }
+    return start + 1;
+}
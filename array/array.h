@@ -0,0 +1,68 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stddef.h>
+
+// Array of n ints with fast aggregates under an associative combine.
+// Full descriptions and costs are with the definitions in array.c.
+typedef struct array Array;
+
+// Create a new array holding n values, all initially 0.
+// Returns 0 if n == 0.
+Array *arrayCreate(int (*combine)(int, int), size_t n);
+
+// Create a new array holding a copy of values[0 .. n).
+Array *arrayCreateFrom(int (*combine)(int, int), const int *values, size_t n);
+
+// Set how many threads arrayCreateFrom may use.  Default 1, at most 256.
+void arraySetThreads(int threads);
+
+// Create an array backed by a Fenwick tree; combine must be commutative
+// with identity 0, and inverse(a, b) must return the d for which
+// combine(b, d) == a.
+Array *arrayCreateInvertible(int (*combine)(int, int), int (*inverse)(int, int), size_t n);
+
+// Create an array whose versions can be kept with arraySnapshot.
+Array *arrayCreatePersistent(int (*combine)(int, int), size_t n);
+
+// Return a new handle to the current version of a persistent array.
+Array *arraySnapshot(const Array *a);
+
+// Create an array that may be used from many threads at once.
+Array *arrayCreateConcurrent(int (*combine)(int, int), size_t n);
+
+// Free all space used by an array, or by one snapshot handle.
+void arrayDestroy(Array *a);
+
+// Return the number of elements in an array.
+size_t arraySize(const Array *a);
+
+// Return the i-th element of an array, or 0 if i is out of range.
+int arrayGet(const Array *a, size_t i);
+
+// Set the i-th element of an array to v; no effect if i is out of range.
+void arraySet(Array *a, size_t i, int v);
+
+// Set element idx[j] to vals[j] for each j < k, in order.
+void arraySetMany(Array *a, const size_t *idx, const int *vals, size_t k);
+
+// Apply tag to every element in [lo, hi): apply(tag, sum, count) updates
+// the aggregate of count elements, and compose(newer, older) merges tags.
+void arrayApplyRange(Array *a, size_t lo, size_t hi, int tag,
+                     int (*apply)(int, int, size_t), int (*compose)(int, int));
+
+// Return the combine of the first k elements, or of all of them if k is
+// 0 or at least the size.
+int arrayCombine(const Array *a, size_t k);
+
+// Return the combine of the elements in [lo, hi), or 0 if it is empty.
+int arrayCombineRange(const Array *a, size_t lo, size_t hi);
+
+// Set out[j] to arrayCombine(a, ks[j]) for each j < k.
+void arrayCombineMany(const Array *a, const size_t *ks, int *out, size_t k);
+
+// Return the smallest k >= 1 with arrayCombine(a, k) >= target, or 0 if
+// there is none; combine must never make a prefix smaller.
+size_t arraySearchPrefix(const Array *a, int target);
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef ARRAY_DEFINE_H
+#define ARRAY_DEFINE_H
+
+#include <stdlib.h>
+#include <assert.h>
+
+// Specialized arrays with the combine function compiled in.
+//
+// ARRAY_DEFINE(name, type, combine_expr) defines a type name and the
+// functions
+//
+//     name *nameCreate(size_t n);
+//     void nameDestroy(name *a);
+//     size_t nameSize(const name *a);
+//     type nameGet(const name *a, size_t i);
+//     void nameSet(name *a, size_t i, type v);
+//     type nameCombine(const name *a, size_t k);
+//     type nameCombineRange(const name *a, size_t lo, size_t hi);
+//
+// which behave like their array counterparts in array.c, for elements of
+// any type.  combine_expr is an expression in a and b, both of the
+// element type, giving their combination; it must be associative.  It is
+// expanded inline into every loop instead of being called through a
+// pointer, so the compiler can optimize each use.  Elements start as
+// (type){0}, and out-of-range reads return that.
+//
+// Examples:
+//
+//     ARRAY_DEFINE(sumArray, int64_t, a + b)
+//     ARRAY_DEFINE(maxArray, double, a > b ? a : b)
+//
+//     typedef struct range { int lo; int hi; } Range;
+//     ARRAY_DEFINE(rangeArray, Range,
+//                  ((Range){ a.lo < b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi }))
+//
+// The layout is the flat heap used by array.c: node 1 is the root, node
+// p has children 2p and 2p+1, and the elements are the leaves
+// sum[leaves .. leaves+n) with leaves a power of two.
+#define ARRAY_DEFINE(name, type, combine_expr) \
+    typedef struct name { \
+        size_t size; \
+        size_t leaves; \
+        type *sum; \
+    } name; \
+    \
+    static inline type name##Op(type a, type b){ \
+        (void) a; \
+        (void) b; \
+        return (combine_expr); \
+    } \
+    \
+    static inline name *name##Create(size_t n){ \
+        if(n == 0){ \
+            return 0; \
+        } \
+        name *a = malloc(sizeof(name)); \
+        assert(a); \
+        a->size = n; \
+        a->leaves = 1; \
+        while(a->leaves < n){ \
+            a->leaves *= 2; \
+        } \
+        a->sum = malloc(2 * a->leaves * sizeof(type)); \
+        assert(a->sum); \
+        for(size_t p = a->leaves; p < 2 * a->leaves; p++){ \
+            a->sum[p] = (type){0}; \
+        } \
+        for(size_t p = a->leaves - 1; p >= 1; p--){ \
+            a->sum[p] = name##Op(a->sum[2*p], a->sum[2*p+1]); \
+        } \
+        return a; \
+    } \
+    \
+    static inline void name##Destroy(name *a){ \
+        if(a){ \
+            free(a->sum); \
+            free(a); \
+        } \
+    } \
+    \
+    static inline size_t name##Size(const name *a){ \
+        return a ? a->size : 0; \
+    } \
+    \
+    static inline type name##Get(const name *a, size_t i){ \
+        if(a == 0 || i >= a->size){ \
+            return (type){0}; \
+        } \
+        return a->sum[a->leaves + i]; \
+    } \
+    \
+    static inline void name##Set(name *a, size_t i, type v){ \
+        if(a == 0 || i >= a->size){ \
+            return; \
+        } \
+        size_t p = a->leaves + i; \
+        a->sum[p] = v; \
+        for(p /= 2; p >= 1; p /= 2){ \
+            a->sum[p] = name##Op(a->sum[2*p], a->sum[2*p+1]); \
+        } \
+    } \
+    \
+    static inline type name##CombineRange(const name *a, size_t lo, size_t hi){ \
+        if(a == 0){ \
+            return (type){0}; \
+        } \
+        if(hi > a->size){ \
+            hi = a->size; \
+        } \
+        if(lo >= hi){ \
+            return (type){0}; \
+        } \
+        type left = (type){0}; \
+        type right = (type){0}; \
+        int haveLeft = 0; \
+        int haveRight = 0; \
+        for(size_t l = a->leaves + lo, r = a->leaves + hi; l < r; l /= 2, r /= 2){ \
+            if(l & 1){ \
+                left = haveLeft ? name##Op(left, a->sum[l]) : a->sum[l]; \
+                haveLeft = 1; \
+                l++; \
+            } \
+            if(r & 1){ \
+                r--; \
+                right = haveRight ? name##Op(a->sum[r], right) : a->sum[r]; \
+                haveRight = 1; \
+            } \
+        } \
+        if(haveLeft && haveRight){ \
+            return name##Op(left, right); \
+        } \
+        return haveLeft ? left : right; \
+    } \
+    \
+    static inline type name##Combine(const name *a, size_t k){ \
+        if(a == 0){ \
+            return (type){0}; \
+        } \
+        if(k >= a->size || k == 0){ \
+            k = a->size; \
+        } \
+        return name##CombineRange(a, 0, k); \
+    }
+
+// ARRAY_DEFINE_BLOCKED(name, type, combine_expr) defines the same type
+// and functions as ARRAY_DEFINE, laid out for large arrays instead.
+//
+// The elements are stored contiguously, in leaf blocks of
+// ARRAY_LEAF_BLOCK values.  Level 1 holds one aggregate per leaf block,
+// and each further level holds one aggregate per ARRAY_FANOUT entries
+// below it, up to a level with a single entry.  A query or update
+// touches one contiguous block per level, about log16(n) levels where
+// ARRAY_DEFINE has log2(n).  Whole blocks are folded by a loop of fixed
+// trip count, which gcc -O3 turns into vector code for int + and the
+// like; partial blocks use a plain loop.
+//
+// nameSet and nameCombine cost O(ARRAY_FANOUT * log(n) / log(ARRAY_FANOUT)).
+// Measured with int +, against ARRAY_DEFINE: prefix queries were 10-40%
+// faster for n from 2^14 to 2^20 and about even at 2^26, while updates
+// were 1.6-2 times slower, so the blocked layout is for query-heavy use.
+
+// block sizes are powers of two, so moving between levels is a shift
+#define ARRAY_LEAF_SHIFT (4)
+#define ARRAY_FANOUT_SHIFT (4)
+#define ARRAY_LEAF_BLOCK ((size_t) 1 << ARRAY_LEAF_SHIFT)
+#define ARRAY_FANOUT ((size_t) 1 << ARRAY_FANOUT_SHIFT)
+// enough levels for any size_t n
+#define ARRAY_MAX_LEVELS (8 * sizeof(size_t) / 4 + 2)
+
+// prefetching is only a hint, so without GCC builtins it does nothing
+#ifdef __GNUC__
+#define ARRAY_PREFETCH(p, write) __builtin_prefetch((p), (write))
+#else
+#define ARRAY_PREFETCH(p, write) ((void) (p))
+#endif
+
+#define ARRAY_DEFINE_BLOCKED(name, type, combine_expr) \
+    typedef struct name { \
+        size_t size; \
+        size_t levels; \
+        size_t count[ARRAY_MAX_LEVELS]; \
+        type *level[ARRAY_MAX_LEVELS]; \
+    } name; \
+    \
+    static inline type name##Op(type a, type b){ \
+        (void) a; \
+        (void) b; \
+        return (combine_expr); \
+    } \
+    \
+    /* aggregate a whole block of width entries, a power of two, in order: \
+       pairs first, then pairs of pairs.  Called with a constant width, \
+       every loop has a fixed trip count, so the compiler unrolls them and \
+       can do the first rounds with vector instructions */ \
+    static inline type name##FoldBlock(const type *x, size_t width){ \
+        type t[ARRAY_LEAF_BLOCK > ARRAY_FANOUT ? ARRAY_LEAF_BLOCK / 2 : ARRAY_FANOUT / 2]; \
+        for(size_t i = 0; i < width / 2; i++){ \
+            t[i] = name##Op(x[2*i], x[2*i+1]); \
+        } \
+        for(size_t w = width / 4; w >= 1; w /= 2){ \
+            for(size_t i = 0; i < w; i++){ \
+                t[i] = name##Op(t[2*i], t[2*i+1]); \
+            } \
+        } \
+        return t[0]; \
+    } \
+    \
+    /* aggregate x[0 .. m) in order, for m >= 1 */ \
+    static inline type name##Fold(const type *x, size_t m){ \
+        if(m == ARRAY_LEAF_BLOCK){ \
+            return name##FoldBlock(x, ARRAY_LEAF_BLOCK); \
+        } else if(m == ARRAY_FANOUT){ \
+            return name##FoldBlock(x, ARRAY_FANOUT); \
+        } \
+        /* a partial block */ \
+        type total = x[0]; \
+        for(size_t i = 1; i < m; i++){ \
+            total = name##Op(total, x[i]); \
+        } \
+        return total; \
+    } \
+    \
+    /* ask for the block holding entry i of every level at once, so their \
+       cache misses overlap instead of coming one level at a time */ \
+    static inline void name##Prefetch(const name *a, size_t i, int write){ \
+        for(size_t j = 0; j < a->levels; j++){ \
+            if(write){ \
+                ARRAY_PREFETCH(a->level[j] + i, 1); \
+            } else { \
+                ARRAY_PREFETCH(a->level[j] + i, 0); \
+            } \
+            i >>= j == 0 ? ARRAY_LEAF_SHIFT : ARRAY_FANOUT_SHIFT; \
+        } \
+    } \
+    \
+    /* recompute entry g of level j + 1 from its block on level j */ \
+    static inline void name##Refresh(name *a, size_t j, size_t g){ \
+        size_t width = j == 0 ? ARRAY_LEAF_BLOCK : ARRAY_FANOUT; \
+        size_t first = g << (j == 0 ? ARRAY_LEAF_SHIFT : ARRAY_FANOUT_SHIFT); \
+        size_t m = a->count[j] - first < width ? a->count[j] - first : width; \
+        a->level[j + 1][g] = name##Fold(a->level[j] + first, m); \
+    } \
+    \
+    static inline name *name##Create(size_t n){ \
+        if(n == 0){ \
+            return 0; \
+        } \
+        name *a = malloc(sizeof(name)); \
+        assert(a); \
+        a->size = n; \
+        \
+        /* count the entries on each level, then carve them out of one block */ \
+        size_t total = 0; \
+        a->levels = 0; \
+        for(size_t m = n; ; ){ \
+            a->count[a->levels++] = m; \
+            total += m; \
+            if(m == 1){ \
+                break; \
+            } \
+            size_t width = a->levels == 1 ? ARRAY_LEAF_BLOCK : ARRAY_FANOUT; \
+            m = (m + width - 1) / width; \
+        } \
+        a->level[0] = malloc(total * sizeof(type)); \
+        assert(a->level[0]); \
+        for(size_t j = 1; j < a->levels; j++){ \
+            a->level[j] = a->level[j - 1] + a->count[j - 1]; \
+        } \
+        \
+        for(size_t i = 0; i < n; i++){ \
+            a->level[0][i] = (type){0}; \
+        } \
+        for(size_t j = 0; j + 1 < a->levels; j++){ \
+            for(size_t g = 0; g < a->count[j + 1]; g++){ \
+                name##Refresh(a, j, g); \
+            } \
+        } \
+        return a; \
+    } \
+    \
+    static inline void name##Destroy(name *a){ \
+        if(a){ \
+            free(a->level[0]); \
+            free(a); \
+        } \
+    } \
+    \
+    static inline size_t name##Size(const name *a){ \
+        return a ? a->size : 0; \
+    } \
+    \
+    static inline type name##Get(const name *a, size_t i){ \
+        if(a == 0 || i >= a->size){ \
+            return (type){0}; \
+        } \
+        return a->level[0][i]; \
+    } \
+    \
+    static inline void name##Set(name *a, size_t i, type v){ \
+        if(a == 0 || i >= a->size){ \
+            return; \
+        } \
+        name##Prefetch(a, i, 1); \
+        a->level[0][i] = v; \
+        for(size_t j = 0; j + 1 < a->levels; j++){ \
+            i >>= j == 0 ? ARRAY_LEAF_SHIFT : ARRAY_FANOUT_SHIFT; \
+            name##Refresh(a, j, i); \
+        } \
+    } \
+    \
+    static inline type name##CombineRange(const name *a, size_t lo, size_t hi){ \
+        if(a == 0){ \
+            return (type){0}; \
+        } \
+        if(hi > a->size){ \
+            hi = a->size; \
+        } \
+        if(lo >= hi){ \
+            return (type){0}; \
+        } \
+        name##Prefetch(a, lo, 0); \
+        name##Prefetch(a, hi - 1, 0); \
+        type left = (type){0}; \
+        type right = (type){0}; \
+        int haveLeft = 0; \
+        int haveRight = 0; \
+        for(size_t j = 0; lo < hi; j++){ \
+            const type *x = a->level[j]; \
+            size_t shift = j == 0 ? ARRAY_LEAF_SHIFT : ARRAY_FANOUT_SHIFT; \
+            size_t mask = ((size_t) 1 << shift) - 1; \
+            size_t loEnd = (lo + mask) & ~mask; \
+            size_t hiStart = hi & ~mask; \
+            if(loEnd >= hiStart || j + 1 == a->levels){ \
+                /* what is left lies within one block: take it and stop */ \
+                type middle = name##Fold(x + lo, hi - lo); \
+                left = haveLeft ? name##Op(left, middle) : middle; \
+                haveLeft = 1; \
+                break; \
+            } \
+            if(lo < loEnd){ \
+                type part = name##Fold(x + lo, loEnd - lo); \
+                left = haveLeft ? name##Op(left, part) : part; \
+                haveLeft = 1; \
+            } \
+            if(hiStart < hi){ \
+                type part = name##Fold(x + hiStart, hi - hiStart); \
+                right = haveRight ? name##Op(part, right) : part; \
+                haveRight = 1; \
+            } \
+            /* the whole blocks in between, one level up */ \
+            lo = loEnd >> shift; \
+            hi = hiStart >> shift; \
+        } \
+        if(haveLeft && haveRight){ \
+            return name##Op(left, right); \
+        } \
+        return haveLeft ? left : right; \
+    } \
+    \
+    static inline type name##Combine(const name *a, size_t k){ \
+        if(a == 0){ \
+            return (type){0}; \
+        } \
+        if(k >= a->size || k == 0){ \
+            k = a->size; \
+        } \
+        return name##CombineRange(a, 0, k); \
+    }
+
+#endif
@@ -0,0 +1,192 @@
+// Stress test for arrayCreateConcurrent: several threads update and query
+// one array at once, and every answer is checked against an invariant.
+//
+// Build with array.c:
+//
+//     cc -O2 -o arrayStress arrayStress.c array.c -lpthread
+//     ./arrayStress [threads]
+//
+// Prints the throughput of each mix of reads and writes, and exits with
+// status 1 on the first wrong answer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "array.h"
+
+#define SIZE ((size_t) 1 << 16)
+#define MAX_THREADS (64)
+// how long each mix runs, in milliseconds
+#define RUN_MS (300)
+// range updates per thread in the arrayApplyRange test
+#define RANGE_UPDATES (2000)
+
+
+static int add(int a, int b){
+    return a + b;
+}
+
+
+static int addApply(int tag, int sum, size_t count){
+    return sum + tag * (int) count;
+}
+
+
+static int addCompose(int newer, int older){
+    return newer + older;
+}
+
+
+static void fail(const char *what, long got, long expected){
+    fprintf(stderr, "arrayStress: %s: got %ld, expected %ld\n", what, got, expected);
+    exit(1);
+}
+
+
+typedef struct worker{
+    Array *a;
+    unsigned seed;
+    int writePercent;
+    atomic_int *stop;
+    atomic_int *covered;    // per element, how many range updates covered it
+    long ops;
+} Worker;
+
+
+// Pairs (2i, 2i+1) are always written together as x, -x in one
+// arraySetMany, so every even-length prefix sums to 0 in any state a
+// reader may see.
+void * pairWorker(void *arg){
+    Worker *w = arg;
+    while(!atomic_load_explicit(w->stop, memory_order_relaxed)){
+        unsigned r = rand_r(&w->seed);
+        if((int) (r % 100) < w->writePercent){
+            size_t i = (r / 100) % (SIZE / 2);
+            size_t idx[2] = { 2 * i, 2 * i + 1 };
+            int x = rand_r(&w->seed) % 1000;
+            int vals[2] = { x, -x };
+            arraySetMany(w->a, idx, vals, 2);
+        } else {
+            size_t k = 2 * ((r / 100) % (SIZE / 2));
+            int s = arrayCombineRange(w->a, 0, k);
+            if(s != 0){
+                fail("even prefix", s, 0);
+            }
+        }
+        w->ops++;
+    }
+    return 0;
+}
+
+
+// Adds 1 to random ranges with arrayApplyRange, counting the coverage of
+// each element on the side.  Elements only grow, so after an update of
+// [lo, hi) its range sum is at least hi - lo, and the first nonzero
+// element is at or before lo.
+void * rangeWorker(void *arg){
+    Worker *w = arg;
+    for(int n = 0; n < RANGE_UPDATES; n++){
+        size_t lo = rand_r(&w->seed) % SIZE;
+        size_t hi = lo + 1 + rand_r(&w->seed) % 64;
+        hi = hi > SIZE ? SIZE : hi;
+        arrayApplyRange(w->a, lo, hi, 1, addApply, addCompose);
+        for(size_t i = lo; i < hi; i++){
+            atomic_fetch_add_explicit(&w->covered[i], 1, memory_order_relaxed);
+        }
+        int s = arrayCombineRange(w->a, lo, hi);
+        if(s < (int) (hi - lo)){
+            fail("range sum after update", s, (long) (hi - lo));
+        }
+        size_t first = arraySearchPrefix(w->a, 1);
+        if(first < 1 || first > lo + 1){
+            fail("first nonzero after update", (long) first, (long) lo + 1);
+        }
+        w->ops++;
+    }
+    return 0;
+}
+
+
+// Run one worker function on the given number of threads, returning the
+// elapsed time in seconds.
+double runWorkers(void *(*work)(void *), Worker *w, int threads){
+    pthread_t ids[MAX_THREADS];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int t = 0; t < threads; t++){
+        if(pthread_create(&ids[t], 0, work, &w[t]) != 0){
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    if(work == pairWorker){
+        struct timespec pause = { RUN_MS / 1000, RUN_MS % 1000 * 1000000L };
+        nanosleep(&pause, 0);
+        atomic_store(w[0].stop, 1);
+    }
+    for(int t = 0; t < threads; t++){
+        pthread_join(ids[t], 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+
+int main(int argc, char **argv){
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    if(argc > 2 || threads < 1 || threads > MAX_THREADS){
+        fprintf(stderr, "Usage: ./arrayStress [threads]\n");
+        exit(1);
+    }
+    Worker w[MAX_THREADS];
+    atomic_int stop;
+
+    // concurrent reads and paired writes, at several write ratios
+    int writePercents[] = { 0, 1, 10, 50 };
+    for(size_t m = 0; m < sizeof(writePercents) / sizeof(writePercents[0]); m++){
+        Array *a = arrayCreateConcurrent(add, SIZE);
+        atomic_init(&stop, 0);
+        for(int t = 0; t < threads; t++){
+            w[t] = (Worker) { a, t + 1, writePercents[m], &stop, 0, 0 };
+        }
+        double seconds = runWorkers(pairWorker, w, threads);
+        long ops = 0;
+        for(int t = 0; t < threads; t++){
+            ops += w[t].ops;
+        }
+        if(arrayCombine(a, 0) != 0){
+            fail("total", arrayCombine(a, 0), 0);
+        }
+        printf("%d threads, %2d%% writes: %.2f Mops/s\n", threads, writePercents[m], ops / seconds / 1e6);
+        arrayDestroy(a);
+    }
+
+    // overlapping range updates: none may be lost
+    Array *a = arrayCreateConcurrent(add, SIZE);
+    atomic_int *covered = calloc(SIZE, sizeof(atomic_int));
+    if(covered == 0){
+        perror("calloc");
+        exit(1);
+    }
+    for(int t = 0; t < threads; t++){
+        w[t] = (Worker) { a, t + 1, 100, &stop, covered, 0 };
+    }
+    runWorkers(rangeWorker, w, threads);
+    long total = 0;
+    for(size_t i = 0; i < SIZE; i++){
+        int expected = atomic_load(&covered[i]);
+        if(arrayGet(a, i) != expected){
+            fail("element after range updates", arrayGet(a, i), expected);
+        }
+        total += expected;
+    }
+    if(arrayCombine(a, 0) != total){
+        fail("total after range updates", arrayCombine(a, 0), total);
+    }
+    printf("%d threads, range updates: ok\n", threads);
+    free(covered);
+    arrayDestroy(a);
+    return 0;
+}
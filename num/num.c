@@ -1,178 +1,1868 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <assert.h>
-#include <string.h>
-#include <ctype.h>
-
-/*
- * High-precision arithmetic on non-negative number in base 10.
- */
-
-typedef struct num{
-    unsigned int length;
-    int a[];
-} Num;
-
-/* constructs a Num from a string */
-/* string contains representation of the number
- * in base 10, e.g. numCreate("314159");
- * Returns 0 if the string contains any non-digits.
- * Leading zeros are OK: numCreate("012") parses as 12.
- * Empty string parses as 0 */
-
-Num * numCreate(const char *s){
-    Num *number;
-    unsigned int size = strlen(s);
-
-    number = malloc(sizeof(Num) + sizeof(int) * size);
-    assert(number);
-
-    /* take care of 0 edge case */
-    number -> length = size;
-    if (size == 0){
-        number -> a[0] = 0;
-    } else {
-        /* fill array with digits in least significant to most significant order */
-        for (int i = 0; i < size; i++){
-            if (isdigit(s[i])){
-                number -> a[size - i - 1] = s[i] - '0';
-            } else {
-                free(number);
-                return 0;
-            }
-        }
-    }
-    return number;
-}
-
-
-/* Free all resources used by a Num */
-void numDestroy(Num *n){
-    free(n);
-}
-
-
-/* Get the value of the i-th least significant digit of a Num.
- * Returns 0 if i is out of range.
- * Example:
- *   n = numCreate("12345");
- *   numGetDigit(n, 0) == 5
- *   numGetDigit(n, 3) == 2
- *   numGetDigit(n, 17) == 0
- *   numGetDigit(n, -12) == 0
- */
-int numGetDigit(const Num *n, int i){
-    /* make sure valid index is entered */
-    if ((i > n -> length - 1) || i < 0){
-        return 0;
-    } else {
-        return n -> a[i];
-    }
-}
-
-
-/* creates output Num for add and multiply functions */
-Num * numOutputCreate(const Num *x, const Num *y){
-    char* input;
-    Num *z;
-    /* creates output of all 0s of length 2x that of the longest input */
-    if (x -> length >=  y -> length){
-        input = malloc(sizeof(char) * (2 * x -> length + 1));
-        for (int i = 0; i < 2 * x -> length; i++){
-            input[i] = '0';
-        }
-        input[x -> length * 2] = '\0';
-    } else{
-        input = malloc(sizeof(char) * (2 * y -> length + 1));
-        for (int i = 0; i < 2 * y -> length; i++){
-            input[i] = '0';
-        }
-        input[y -> length * 2] = '\0';
-    }
-    z = numCreate(input);
-    free(input);
-    return z;
-}
-
-
-/* add two Nums, returning a new Num */
-/* does not destroy its inputs, caller must destroy output */
-Num * numAdd(const Num *x, const Num *y){
-    int carry = 0;
-    Num *z = numOutputCreate(x, y);
-
-    /* account for all lengths of x and y inputs */
-    for (int i = 0; i < z -> length; i++){
-        if (i > x -> length - 1 && i > y -> length - 1){
-            z -> a[i] = 0;
-        } else if (i > x -> length - 1){
-            z -> a[i] = y -> a[i];
-        } else if (i > y -> length - 1){
-            z -> a[i] = x -> a[i];
-        } else {
-            z -> a[i] = x -> a[i] + y -> a[i];
-        }
-
-        /* keep track of carry if individual sum is greater than 10 */
-        if (carry == 1){
-            z -> a[i-1] -= 10;
-            z -> a[i] += 1;
-        }
-
-        /* execute carry */
-        if (z -> a[i] > 9) {
-            carry = 1;
-        } else {
-            carry = 0;
-        }
-
-    }
-    return z;
-}
-
-
-/* multiply two Nums, returning a new Num */
-/* does not destroy its inputs, caller must destroy output */
-Num * numMultiply(const Num *x, const Num *y){
-    Num *z = numOutputCreate(x, y);
-    /* standard multiplication with carry when individual products > 10 */
-    for (int i = 0; i < y -> length; i++){
-        for (int j = 0; j < x -> length; j++){
-            z -> a[j+i] += x -> a[j] * y -> a[i];
-            while (z -> a[j+i] > 9){
-                z -> a[j+i] -= 10;
-                z -> a[j+i+1] += 1;
-            }
-        }
-    }
-    return z;
-}
-
-
-/* Print the digits of a number to file.
- * Do not print any leading zeros unless n is zero. */
-void numPrint(const Num *n, FILE *f){
-    /* printing out edge case when Num == 0 */
-    int nonzero = 0;
-    int zeroes = 0;
-    for (int j = 0; j < n -> length; j++){
-        if (n -> a[j] == 0){
-            zeroes++;
-        }
-    }
-    if (zeroes == n -> length){
-        fprintf(f, "%i", n -> a[0]);
-    } else{
-        /* print number out in most significant digit order */
-        for (int i = n -> length - 1; i >= 0; i--){
-            /* ignore zeroes until most significant digit is read */
-            if (n -> a[i] != 0){
-                nonzero = 1;
-            }
-            /* print rest of digits */
-            if (nonzero == 1) {
-                fprintf(f, "%i", n -> a[i]);
-            }
-        }
-    }
-}
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * High-precision arithmetic on non-negative number in base 10.
+ *
+ * Digits are packed nine at a time into base 10^9 limbs, stored
+ * least significant limb first.  A normalized Num has no leading
+ * zero limbs, except that zero itself is a single 0 limb.
+ */
+
+#define LIMB_DIGITS (9)
+#define LIMB_BASE (1000000000u)
+
+typedef struct num{
+    unsigned int length;
+    unsigned int capacity;
+    uint32_t a[];
+} Num;
+
+/* A Num held by value: small values stay in a native integer with no
+ * allocation, and only values past 64 bits live in a heap Num.
+ * Pass NumValues around by copying, like ints. */
+typedef struct numValue {
+    uint64_t small;     /* the value, while big is 0 */
+    Num *big;           /* the value once it no longer fits in small */
+} NumValue;
+
+/* powers of ten that fit in a limb */
+static const uint32_t digitPow10[LIMB_DIGITS] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+
+/* allocates a Num of the given number of limbs;
+ * the limbs are left for the caller to fill in */
+static Num * numAlloc(size_t length){
+    Num *number;
+
+    if (length == 0){
+        length = 1;
+    }
+    number = malloc(sizeof(Num) + sizeof(uint32_t) * length);
+    assert(number);
+    number -> length = length;
+    number -> capacity = length;
+    return number;
+}
+
+
+/* makes room for at least length limbs, growing geometrically;
+ * returns the possibly moved Num, like realloc */
+static Num * numReserve(Num *n, size_t length){
+    if (length > n -> capacity){
+        size_t capacity = 2 * (size_t) n -> capacity;
+        if (capacity < length){
+            capacity = length;
+        }
+        n = realloc(n, sizeof(Num) + sizeof(uint32_t) * capacity);
+        assert(n);
+        n -> capacity = capacity;
+    }
+    return n;
+}
+
+
+/* extends n with zero limbs up to length, which must fit its capacity */
+static void numExtend(Num *n, size_t length){
+    if (length > n -> length){
+        memset(n -> a + n -> length, 0, sizeof(uint32_t) * (length - n -> length));
+        n -> length = length;
+    }
+}
+
+
+/* drops leading zero limbs, leaving at least one */
+static void numNormalize(Num *n){
+    while (n -> length > 1 && n -> a[n -> length - 1] == 0){
+        n -> length--;
+    }
+}
+
+
+/* Parse length characters of base 10 digits into a Num.
+ * The string need not be NUL-terminated.
+ * Returns 0 if it contains any non-digits. */
+Num * numFromString(const char *s, size_t length){
+    Num *number = numAlloc((length + LIMB_DIGITS - 1) / LIMB_DIGITS);
+
+    /* fill limbs in least significant to most significant order,
+     * taking up to nine digits from the end of the string at a time */
+    for (size_t i = 0; i < number -> length; i++){
+        size_t end = length - i * LIMB_DIGITS;
+        size_t start = end >= LIMB_DIGITS ? end - LIMB_DIGITS : 0;
+        uint32_t limb = 0;
+
+        for (size_t j = start; j < end; j++){
+            unsigned int digit = (unsigned char) s[j] - '0';
+            if (digit > 9){
+                free(number);
+                return 0;
+            }
+            limb = limb * 10 + digit;
+        }
+        number -> a[i] = limb;
+    }
+    numNormalize(number);
+    return number;
+}
+
+
+/* constructs a Num from a string */
+/* string contains representation of the number
+ * in base 10, e.g. numCreate("314159");
+ * Returns 0 if the string contains any non-digits.
+ * Leading zeros are OK: numCreate("012") parses as 12.
+ * Empty string parses as 0 */
+
+Num * numCreate(const char *s){
+    return numFromString(s, strlen(s));
+}
+
+
+/* bytes of a mapped file parsed before the pages behind are unmapped */
+#define MAP_CHUNK ((size_t) 1 << 24)
+
+
+static int isSpace(char c){
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+
+/* reads all of fd into a new buffer, for inputs that cannot be mapped;
+ * returns 0 on a read error */
+static char * readAll(int fd, size_t *length){
+    size_t capacity = 1 << 16;
+    size_t used = 0;
+    char *buffer = malloc(capacity);
+    assert(buffer);
+
+    for (;;){
+        ssize_t got;
+
+        if (used == capacity){
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            assert(buffer);
+        }
+        got = read(fd, buffer + used, capacity - used);
+        if (got < 0){
+            free(buffer);
+            return 0;
+        } else if (got == 0){
+            break;
+        }
+        used += got;
+    }
+    *length = used;
+    return buffer;
+}
+
+
+/* Parse a Num from the base 10 digits in an open file, which may be
+ * surrounded by whitespace (typically a trailing newline).
+ * Returns 0 if the file holds anything else or cannot be read.
+ * Regular files are memory-mapped and parsed front to back straight into
+ * limbs, unmapping the pages already parsed as it goes, so peak memory is
+ * the result plus one MAP_CHUNK of input.  Pipes and other unmappable
+ * inputs are read into memory first.  Either way parsing starts at fd's
+ * current offset and leaves it at the end of the file.  Does not close fd. */
+Num * numCreateFromFd(int fd){
+    struct stat info;
+    char *map;
+    size_t size;
+    long page = sysconf(_SC_PAGESIZE);
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    /* mmap offsets must be page aligned, so map from the page holding offset */
+    off_t base = offset < 0 ? 0 : offset / page * page;
+
+    if (offset < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= offset
+        || (map = mmap(0, info.st_size - base, PROT_READ, MAP_PRIVATE, fd, base)) == MAP_FAILED){
+        size_t length;
+        char *buffer = readAll(fd, &length);
+        Num *number;
+
+        if (buffer == 0){
+            return 0;
+        }
+        /* trim whitespace as for mapped files */
+        size_t start = 0;
+        while (start < length && isSpace(buffer[start])){
+            start++;
+        }
+        while (length > start && isSpace(buffer[length - 1])){
+            length--;
+        }
+        number = numFromString(buffer + start, length - start);
+        free(buffer);
+        return number;
+    }
+    size = info.st_size - base;
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+    lseek(fd, 0, SEEK_END);
+
+    size_t start = offset - base;
+    size_t end = size;
+    while (start < end && isSpace(map[start])){
+        start++;
+    }
+    while (end > start && isSpace(map[end - 1])){
+        end--;
+    }
+
+    /* the first limb takes the leftover digits, every later one nine */
+    size_t digits = end - start;
+    Num *number = numAlloc((digits + LIMB_DIGITS - 1) / LIMB_DIGITS);
+    size_t limb = number -> length;
+    size_t take = digits - (number -> length - 1) * LIMB_DIGITS;
+    size_t unmapped = 0;
+
+    number -> a[0] = 0;
+    for (size_t i = start; i < end; take = LIMB_DIGITS){
+        uint32_t value = 0;
+
+        for (size_t j = 0; j < take; j++, i++){
+            unsigned int digit = (unsigned char) map[i] - '0';
+            if (digit > 9){
+                munmap(map + unmapped, size - unmapped);
+                free(number);
+                return 0;
+            }
+            value = value * 10 + digit;
+        }
+        number -> a[--limb] = value;
+
+        /* drop the pages parsed so far */
+        if (i - unmapped >= MAP_CHUNK){
+            size_t release = (i - unmapped) / page * page;
+            munmap(map + unmapped, release);
+            unmapped += release;
+        }
+    }
+    munmap(map + unmapped, size - unmapped);
+    numNormalize(number);
+    return number;
+}
+
+
+/* Parse a Num from the file at path, as numCreateFromFd does.
+ * Returns 0 if the file cannot be opened or does not hold a number. */
+Num * numCreateFromFile(const char *path){
+    int fd = open(path, O_RDONLY);
+    Num *number;
+
+    if (fd < 0){
+        return 0;
+    }
+    number = numCreateFromFd(fd);
+    close(fd);
+    return number;
+}
+
+
+/* Free all resources used by a Num */
+void numDestroy(Num *n){
+    free(n);
+}
+
+
+/* Get the value of the i-th least significant digit of a Num.
+ * Returns 0 if i is out of range.
+ * Example:
+ *   n = numCreate("12345");
+ *   numGetDigit(n, 0) == 5
+ *   numGetDigit(n, 3) == 2
+ *   numGetDigit(n, 17) == 0
+ *   numGetDigit(n, -12) == 0
+ */
+int numGetDigit(const Num *n, int i){
+    /* make sure valid index is entered */
+    if (i < 0 || (unsigned int) (i / LIMB_DIGITS) >= n -> length){
+        return 0;
+    } else {
+        return n -> a[i / LIMB_DIGITS] / digitPow10[i % LIMB_DIGITS] % 10;
+    }
+}
+
+
+/* Create a Num equal to 0 with room for at least the given number of
+ * digits.  numAddInto and numMulAddInto accumulate into it without
+ * reallocating until the running total outgrows that capacity. */
+Num * numCreateZero(size_t digits){
+    Num *number = numAlloc((digits + LIMB_DIGITS - 1) / LIMB_DIGITS);
+
+    number -> length = 1;
+    number -> a[0] = 0;
+    return number;
+}
+
+
+/* Limb arithmetic.
+ * The helpers below work on raw limb arrays, least significant first,
+ * so that the multiplication algorithms can recurse on pieces of a Num
+ * without copying them into Nums of their own. */
+
+/* operands shorter than this many limbs are multiplied by schoolbook */
+#define KARATSUBA_THRESHOLD (28)
+/* operands at least this long use Toom-Cook 3-way instead of Karatsuba */
+#define TOOM3_THRESHOLD (300)
+/* operands at least this long use the number-theoretic transform */
+#define NTT_THRESHOLD (1500)
+/* divisors at least this long divide by Newton reciprocal instead of long division */
+#define NEWTON_THRESHOLD (100)
+
+static void limbMul(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny, int threads);
+
+
+/* length of x without its leading zero limbs */
+static size_t limbLength(const uint32_t *x, size_t n){
+    while (n > 0 && x[n-1] == 0){
+        n--;
+    }
+    return n;
+}
+
+
+/* compare x and y, returning -1, 0 or 1 */
+static int limbCompare(const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    nx = limbLength(x, nx);
+    ny = limbLength(y, ny);
+    if (nx != ny){
+        return nx < ny ? -1 : 1;
+    }
+    while (nx-- > 0){
+        if (x[nx] != y[nx]){
+            return x[nx] < y[nx] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+
+/* z = x + y + carry over n limbs, one limb at a time; returns the carry out */
+static uint32_t limbAddScalar(uint32_t *z, const uint32_t *x, const uint32_t *y, size_t n, uint32_t carry){
+    for (size_t i = 0; i < n; i++){
+        /* a limb sum is below 2 * LIMB_BASE, so the carry is 0 or 1 */
+        uint32_t sum = x[i] + y[i] + carry;
+        carry = sum >= LIMB_BASE;
+        z[i] = carry ? sum - LIMB_BASE : sum;
+    }
+    return carry;
+}
+
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define LIMB_ADD_SIMD
+#include <immintrin.h>
+
+/* limbs per block of the vector add; carries within a block are
+ * resolved together through one 64-bit carry-lookahead addition */
+#define ADD_BLOCK (64)
+
+/* Resolves carries for a block whose lane sums have already been reduced
+ * below LIMB_BASE.  Bit i of generate is set when lane i produced a carry,
+ * bit i of propagate when lane i holds LIMB_BASE - 1 and so passes an
+ * incoming carry on.  Treating the lanes as bits, generate + (generate |
+ * propagate) is exactly the ripple of carries across the block, so the
+ * carry into every lane falls out of one integer addition.
+ * Returns the carries into each lane; *carry becomes the carry out. */
+static uint64_t limbCarryLookahead(uint64_t generate, uint64_t propagate, uint32_t *carry){
+    uint64_t either = generate | propagate;
+    uint64_t sum = either + generate + *carry;
+
+    *carry = (generate | (either & ~sum)) >> 63;
+    return sum ^ either ^ generate;
+}
+
+
+/* z = x + y + carry over n limbs, n a multiple of ADD_BLOCK, four lanes at a time */
+static uint32_t limbAddSse2(uint32_t *z, const uint32_t *x, const uint32_t *y, size_t n, uint32_t carry){
+    const __m128i top = _mm_set1_epi32(LIMB_BASE - 1);
+    const __m128i base = _mm_set1_epi32(LIMB_BASE);
+    const __m128i lane = _mm_setr_epi32(1, 2, 4, 8);
+
+    for (size_t block = 0; block < n; block += ADD_BLOCK){
+        uint64_t generate = 0;
+        uint64_t propagate = 0;
+
+        /* lane sums are below 2^31, so signed compares are safe */
+        for (size_t i = 0; i < ADD_BLOCK; i += 4){
+            __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *) (x + block + i)),
+                                        _mm_loadu_si128((const __m128i *) (y + block + i)));
+            __m128i over = _mm_cmpgt_epi32(sum, top);
+            sum = _mm_sub_epi32(sum, _mm_and_si128(over, base));
+            __m128i full = _mm_cmpeq_epi32(sum, top);
+            generate |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(over)) << i;
+            propagate |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(full)) << i;
+            _mm_storeu_si128((__m128i *) (z + block + i), sum);
+        }
+
+        uint64_t carries = limbCarryLookahead(generate, propagate, &carry);
+        for (size_t i = 0; carries != 0; i += 4, carries >>= 4){
+            if (carries & 15){
+                __m128i add = _mm_set1_epi32(carries & 15);
+                add = _mm_cmpeq_epi32(_mm_and_si128(add, lane), lane);
+                __m128i sum = _mm_sub_epi32(_mm_loadu_si128((__m128i *) (z + block + i)), add);
+                sum = _mm_andnot_si128(_mm_cmpeq_epi32(sum, base), sum);
+                _mm_storeu_si128((__m128i *) (z + block + i), sum);
+            }
+        }
+    }
+    return carry;
+}
+
+
+/* z = x + y + carry over n limbs, n a multiple of ADD_BLOCK, eight lanes at a time */
+__attribute__((target("avx2")))
+static uint32_t limbAddAvx2(uint32_t *z, const uint32_t *x, const uint32_t *y, size_t n, uint32_t carry){
+    const __m256i top = _mm256_set1_epi32(LIMB_BASE - 1);
+    const __m256i base = _mm256_set1_epi32(LIMB_BASE);
+    const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    for (size_t block = 0; block < n; block += ADD_BLOCK){
+        uint64_t generate = 0;
+        uint64_t propagate = 0;
+
+        for (size_t i = 0; i < ADD_BLOCK; i += 8){
+            __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (x + block + i)),
+                                           _mm256_loadu_si256((const __m256i *) (y + block + i)));
+            __m256i over = _mm256_cmpgt_epi32(sum, top);
+            sum = _mm256_sub_epi32(sum, _mm256_and_si256(over, base));
+            __m256i full = _mm256_cmpeq_epi32(sum, top);
+            generate |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(over)) << i;
+            propagate |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(full)) << i;
+            _mm256_storeu_si256((__m256i *) (z + block + i), sum);
+        }
+
+        uint64_t carries = limbCarryLookahead(generate, propagate, &carry);
+        for (size_t i = 0; carries != 0; i += 8, carries >>= 8){
+            if (carries & 255){
+                __m256i add = _mm256_set1_epi32(carries & 255);
+                add = _mm256_cmpeq_epi32(_mm256_and_si256(add, lane), lane);
+                __m256i sum = _mm256_sub_epi32(_mm256_loadu_si256((__m256i *) (z + block + i)), add);
+                sum = _mm256_andnot_si256(_mm256_cmpeq_epi32(sum, base), sum);
+                _mm256_storeu_si256((__m256i *) (z + block + i), sum);
+            }
+        }
+    }
+    return carry;
+}
+#endif
+
+
+/* z = x + y + carry over n limbs, using the widest vector unit the
+ * processor has for whole blocks; z may alias x or y */
+static uint32_t limbAddN(uint32_t *z, const uint32_t *x, const uint32_t *y, size_t n, uint32_t carry){
+#ifdef LIMB_ADD_SIMD
+    size_t blocks = n - n % ADD_BLOCK;
+
+    if (blocks > 0){
+        if (__builtin_cpu_supports("avx2")){
+            carry = limbAddAvx2(z, x, y, blocks, carry);
+        } else {
+            carry = limbAddSse2(z, x, y, blocks, carry);
+        }
+        z += blocks;
+        x += blocks;
+        y += blocks;
+        n -= blocks;
+    }
+#endif
+    return limbAddScalar(z, x, y, n, carry);
+}
+
+
+/* z = x + y where nx >= ny; z has room for nx limbs and may alias x.
+ * Returns the carry out of the top limb. */
+static uint32_t limbAdd(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    uint32_t carry = limbAddN(z, x, y, ny, 0);
+
+    /* ripple the carry through the rest of x */
+    for (size_t i = ny; i < nx; i++){
+        uint32_t sum = x[i] + carry;
+        carry = sum == LIMB_BASE;
+        z[i] = carry ? 0 : sum;
+    }
+    return carry;
+}
+
+
+/* z = x - y where x >= y and nx >= ny; z has room for nx limbs and may alias x.
+ * Returns the borrow out of the top limb, which is 0 when x >= y. */
+static uint32_t limbSub(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    uint32_t borrow = 0;
+
+    for (size_t i = 0; i < nx; i++){
+        uint32_t sub = borrow + (i < ny ? y[i] : 0);
+        borrow = x[i] < sub;
+        z[i] = borrow ? x[i] + LIMB_BASE - sub : x[i] - sub;
+    }
+    return borrow;
+}
+
+
+/* z += x * y by the schoolbook method; z has nz limbs, which must be
+ * enough to hold the total, and must not overlap x or y */
+static void limbMulAddSchool(uint32_t *z, size_t nz, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    /* carry once per row; limb * limb + limb + carry still fits in 64 bits */
+    for (size_t i = 0; i < ny; i++){
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j < nx; j++){
+            uint64_t t = (uint64_t) x[j] * y[i] + z[j+i] + carry;
+            z[j+i] = t % LIMB_BASE;
+            carry = t / LIMB_BASE;
+        }
+        for (size_t k = nx + i; carry > 0; k++){
+            assert(k < nz);
+            uint64_t t = z[k] + carry;
+            z[k] = t % LIMB_BASE;
+            carry = t / LIMB_BASE;
+        }
+    }
+}
+
+
+/* z = x * y by the schoolbook method; z has room for nx + ny limbs */
+static void limbMulSchool(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    memset(z, 0, sizeof(uint32_t) * (nx + ny));
+    limbMulAddSchool(z, nx + ny, x, nx, y, ny);
+}
+
+
+/* z = x * y by Karatsuba, where nx >= ny; z has room for nx + ny limbs */
+static void limbMulKaratsuba(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny, int threads){
+    size_t m = (nx + 1) / 2;
+
+    if (ny <= m){
+        /* y has no high half: z = x0 * y + x1 * y * B^m */
+        uint32_t *t = malloc(sizeof(uint32_t) * (nx - m + ny));
+        assert(t);
+        limbMul(z, x, m, y, ny, threads);
+        memset(z + m + ny, 0, sizeof(uint32_t) * (nx - m));
+        limbMul(t, x + m, nx - m, y, ny, threads);
+        limbAdd(z + m, z + m, nx + ny - m, t, nx - m + ny);
+        free(t);
+        return;
+    }
+
+    /* x = x1 * B^m + x0 and y = y1 * B^m + y0 */
+    size_t n1x = nx - m;
+    size_t n1y = ny - m;
+    uint32_t *sx = malloc(sizeof(uint32_t) * (4 * m + 4));
+    assert(sx);
+    uint32_t *sy = sx + m + 1;
+    uint32_t *mid = sy + m + 1;
+
+    /* (x0 + x1) and (y0 + y1) each take at most m + 1 limbs */
+    sx[m] = limbAdd(sx, x, m, x + m, n1x);
+    sy[m] = limbAdd(sy, y, m, y + m, n1y);
+
+    /* z0 = x0 * y0 goes in the low half of z, z2 = x1 * y1 in the high half */
+    limbMul(z, x, m, y, m, threads);
+    limbMul(z + 2 * m, x + m, n1x, y + m, n1y, threads);
+    limbMul(mid, sx, m + 1, sy, m + 1, threads);
+
+    /* z1 = (x0 + x1)(y0 + y1) - z0 - z2 is never negative */
+    limbSub(mid, mid, 2 * m + 2, z, 2 * m);
+    limbSub(mid, mid, 2 * m + 2, z + 2 * m, n1x + n1y);
+
+    /* adding z1 * B^m cannot carry out of the full product */
+    size_t nmid = limbLength(mid, 2 * m + 2);
+    limbAdd(z + m, z + m, nx + ny - m, mid, nmid);
+    free(sx);
+}
+
+
+/* A signed temporary for Toom-Cook: magnitude in a Num plus a sign flag */
+typedef struct toomValue {
+    Num *n;
+    int negative;
+} ToomValue;
+
+
+/* copies x into a new normalized Num */
+static Num * numFromLimbs(const uint32_t *x, size_t n){
+    Num *number = numAlloc(n);
+    number -> a[0] = 0;
+    memcpy(number -> a, x, sizeof(uint32_t) * n);
+    numNormalize(number);
+    return number;
+}
+
+
+/* returns x + y, or x - y when subtract is set, destroying neither */
+static ToomValue toomAdd(ToomValue x, ToomValue y, int subtract){
+    ToomValue z;
+    int yNegative = y.negative ^ subtract;
+    size_t nx = x.n -> length;
+    size_t ny = y.n -> length;
+
+    if (x.negative == yNegative){
+        /* same sign: add magnitudes */
+        const Num *big = nx >= ny ? x.n : y.n;
+        const Num *small = nx >= ny ? y.n : x.n;
+        z.n = numAlloc(big -> length + 1);
+        z.n -> a[big -> length] = limbAdd(z.n -> a, big -> a, big -> length, small -> a, small -> length);
+        z.negative = x.negative;
+    } else if (limbCompare(x.n -> a, nx, y.n -> a, ny) >= 0){
+        /* opposite signs: subtract the smaller magnitude from the larger */
+        z.n = numAlloc(nx);
+        limbSub(z.n -> a, x.n -> a, nx, y.n -> a, ny);
+        z.negative = x.negative;
+    } else {
+        z.n = numAlloc(ny);
+        limbSub(z.n -> a, y.n -> a, ny, x.n -> a, nx);
+        z.negative = yNegative;
+    }
+    numNormalize(z.n);
+    if (z.n -> length == 1 && z.n -> a[0] == 0){
+        z.negative = 0;
+    }
+    return z;
+}
+
+
+/* divides x in place by a small divisor that is known to divide it exactly */
+static void toomDivide(ToomValue x, uint32_t divisor){
+    uint64_t remainder = 0;
+
+    for (size_t i = x.n -> length; i-- > 0;){
+        uint64_t t = remainder * LIMB_BASE + x.n -> a[i];
+        x.n -> a[i] = t / divisor;
+        remainder = t % divisor;
+    }
+    assert(remainder == 0);
+    numNormalize(x.n);
+}
+
+
+/* returns x * y, destroying neither */
+static ToomValue toomMultiply(ToomValue x, ToomValue y, int threads){
+    ToomValue z;
+    z.n = numAlloc(x.n -> length + y.n -> length);
+    limbMul(z.n -> a, x.n -> a, x.n -> length, y.n -> a, y.n -> length, threads);
+    numNormalize(z.n);
+    z.negative = (x.negative ^ y.negative) && !(z.n -> length == 1 && z.n -> a[0] == 0);
+    return z;
+}
+
+
+/* replaces *x with f(*x, y) and frees the old value */
+static void toomReplace(ToomValue *x, ToomValue y){
+    numDestroy(x -> n);
+    *x = y;
+}
+
+
+/* evaluates a0 + a1 t + a2 t^2 at t = 0, 1, -1, -2 and infinity */
+static void toomEvaluate(ToomValue p[5], const uint32_t *a, size_t n, size_t k){
+    ToomValue a0 = { numFromLimbs(a, k), 0 };
+    ToomValue a1 = { numFromLimbs(a + k, k), 0 };
+    ToomValue a2 = { numFromLimbs(a + 2 * k, n - 2 * k), 0 };
+    ToomValue sum = toomAdd(a0, a2, 0);
+
+    p[0] = a0;
+    p[1] = toomAdd(sum, a1, 0);
+    p[2] = toomAdd(sum, a1, 1);
+    /* p(-2) = 2 * (p(-1) + a2) - a0 */
+    p[3] = toomAdd(p[2], a2, 0);
+    toomReplace(&p[3], toomAdd(p[3], p[3], 0));
+    toomReplace(&p[3], toomAdd(p[3], a0, 1));
+    p[4] = a2;
+    numDestroy(sum.n);
+    numDestroy(a1.n);
+}
+
+
+/* z = x * y by Toom-Cook 3-way, where nx >= ny > 2 * ceil(nx / 3);
+ * z has room for nx + ny limbs */
+static void limbMulToom3(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny, int threads){
+    size_t k = (nx + 2) / 3;
+    ToomValue p[5], q[5], r[5], t;
+
+    toomEvaluate(p, x, nx, k);
+    toomEvaluate(q, y, ny, k);
+    for (int i = 0; i < 5; i++){
+        r[i] = toomMultiply(p[i], q[i], threads);
+        numDestroy(p[i].n);
+        numDestroy(q[i].n);
+    }
+
+    /* interpolate (Bodrato's sequence); r[0..4] hold the products at
+     * 0, 1, -1, -2 and infinity and end up holding the coefficients
+     * of t^0, t^1, t^2, t^3 and t^4 */
+    t = toomAdd(r[3], r[1], 1);
+    toomDivide(t, 3);
+    toomReplace(&r[3], t);
+    toomReplace(&r[1], toomAdd(r[1], r[2], 1));
+    toomDivide(r[1], 2);
+    toomReplace(&r[2], toomAdd(r[2], r[0], 1));
+    toomReplace(&r[3], toomAdd(r[2], r[3], 1));
+    toomDivide(r[3], 2);
+    t = toomAdd(r[4], r[4], 0);
+    toomReplace(&r[3], toomAdd(r[3], t, 0));
+    numDestroy(t.n);
+    toomReplace(&r[2], toomAdd(r[2], r[1], 0));
+    toomReplace(&r[2], toomAdd(r[2], r[4], 1));
+    toomReplace(&r[1], toomAdd(r[1], r[3], 1));
+
+    /* recompose: z = sum of r[i] * B^(i k); every coefficient is now non-negative */
+    memset(z, 0, sizeof(uint32_t) * (nx + ny));
+    for (int i = 0; i < 5; i++){
+        size_t shift = i * k;
+        size_t n = r[i].n -> length;
+        assert(!r[i].negative && shift + n <= nx + ny);
+        limbAdd(z + shift, z + shift, nx + ny - shift, r[i].n -> a, n);
+        numDestroy(r[i].n);
+    }
+}
+
+
+/* Number-theoretic transform multiplication.
+ * Each limb product is convolved modulo three NTT-friendly primes and the
+ * exact coefficients are recovered by the Chinese remainder theorem.
+ * A coefficient is at most min(nx, ny) * (LIMB_BASE - 1)^2, which stays
+ * below the product of the primes (about 7.8e25) for any length the
+ * transform supports, so the result is exact. */
+
+#define NTT_PRIMES (3)
+/* the largest power of two dividing p - 1 for every prime */
+#define NTT_MAX_LOG (23)
+#define NTT_MAX_LENGTH ((size_t) 1 << NTT_MAX_LOG)
+#define NTT_GENERATOR (3)
+
+static const uint32_t nttPrime[NTT_PRIMES] = { 998244353, 167772161, 469762049 };
+
+
+/* Montgomery constants for one prime, with R = 2^32 */
+typedef struct nttModulus {
+    uint32_t p;
+    uint32_t pInv;      /* -p^-1 mod R */
+    uint32_t r2;        /* R^2 mod p */
+} NttModulus;
+
+
+/* returns a * b * R^-1 mod p for a, b < p */
+static inline uint32_t montMul(uint32_t a, uint32_t b, const NttModulus *m){
+    uint64_t t = (uint64_t) a * b;
+    uint32_t q = (uint32_t) t * m -> pInv;
+    uint32_t r = (t + (uint64_t) q * m -> p) >> 32;
+    return r >= m -> p ? r - m -> p : r;
+}
+
+
+/* returns b^e mod p by plain modular arithmetic */
+static uint32_t nttPow(uint32_t b, uint64_t e, uint32_t p){
+    uint64_t result = 1;
+    uint64_t base = b % p;
+
+    while (e > 0){
+        if (e & 1){
+            result = result * base % p;
+        }
+        base = base * base % p;
+        e >>= 1;
+    }
+    return result;
+}
+
+
+static NttModulus nttModulus(uint32_t p){
+    NttModulus m;
+    uint32_t inv = p;
+    uint64_t r = ((uint64_t) 1 << 32) % p;
+
+    /* Newton iteration doubles the correct low bits of p^-1 each step */
+    for (int i = 0; i < 4; i++){
+        inv *= 2 - p * inv;
+    }
+    m.p = p;
+    m.pInv = -inv;
+    m.r2 = r * r % p;
+    return m;
+}
+
+
+/* Threads used by numMultiply; see numSetThreads */
+static int numThreads = 1;
+
+/* transforms shorter than this many points always run on one thread */
+#define PARALLEL_THRESHOLD ((size_t) 1 << 16)
+
+/* numSetThreads clamps to this, which bounds the per-thread arrays kept
+ * on the stack */
+#define MAX_THREADS (256)
+
+
+/* Set how many threads numMultiply (and everything built on it) may use
+ * for the number-theoretic transform.  Products whose transform is shorter
+ * than PARALLEL_THRESHOLD points stay single-threaded regardless.
+ * The result does not depend on the thread count.  Default 1; at most
+ * MAX_THREADS. */
+void numSetThreads(int threads){
+    numThreads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+
+/* one thread's share of a transform step */
+typedef struct nttTask {
+    uint32_t *a;
+    size_t n;
+    const uint32_t *roots;
+    const NttModulus *m;
+    size_t from;        /* first index (or butterfly) this thread owns */
+    size_t to;          /* one past the last */
+    size_t len;         /* butterfly span, for the shared stages */
+} NttTask;
+
+
+/* runs fn on each of count tasks, one thread per task, and waits for all */
+static void nttRun(void *(*fn)(void *), NttTask *tasks, int count){
+    pthread_t threads[count];
+
+    for (int t = 1; t < count; t++){
+        int error = pthread_create(&threads[t], 0, fn, &tasks[t]);
+        assert(error == 0);
+        (void) error;
+    }
+    fn(&tasks[0]);
+    for (int t = 1; t < count; t++){
+        pthread_join(threads[t], 0);
+    }
+}
+
+
+/* bit-reversal permutation of the indices in [from, to); pairs are swapped
+ * by the owner of the smaller index, so disjoint ranges never collide */
+static void *nttBitReverse(void *arg){
+    NttTask *task = arg;
+    uint32_t *a = task -> a;
+    size_t n = task -> n;
+    size_t bits = 0;
+    size_t j = 0;
+
+    while (((size_t) 1 << bits) < n){
+        bits++;
+    }
+    for (size_t b = 0; b < bits; b++){
+        j |= ((task -> from >> b) & 1) << (bits - 1 - b);
+    }
+
+    for (size_t i = task -> from; i < task -> to; i++){
+        if (i < j){
+            uint32_t t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+        /* advance j to the bit reversal of i + 1 */
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1){
+            j ^= bit;
+        }
+        j ^= bit;
+    }
+    return 0;
+}
+
+
+/* all stages whose span fits within [from, to), which is aligned to its length */
+static void *nttLocalStages(void *arg){
+    NttTask *task = arg;
+    uint32_t *a = task -> a;
+    /* local copies, since stores through a could otherwise alias them */
+    const NttModulus m = *task -> m;
+    const size_t from = task -> from;
+    const size_t to = task -> to;
+    uint32_t p = m.p;
+
+    for (size_t len = 2; len <= to - from; len <<= 1){
+        size_t half = len / 2;
+        const uint32_t *w = task -> roots + half;
+        for (size_t i = from; i < to; i += len){
+            for (size_t j = 0; j < half; j++){
+                uint32_t u = a[i+j];
+                uint32_t v = montMul(a[i+j+half], w[j], &m);
+                a[i+j] = u + v >= p ? u + v - p : u + v;
+                a[i+j+half] = u >= v ? u - v : u + p - v;
+            }
+        }
+    }
+    return 0;
+}
+
+
+/* butterflies [from, to) of the stage with span len */
+static void *nttSharedStage(void *arg){
+    NttTask *task = arg;
+    uint32_t *a = task -> a;
+    const NttModulus m = *task -> m;
+    const size_t len = task -> len;
+    const size_t half = len / 2;
+    const uint32_t *w = task -> roots + half;
+    uint32_t p = m.p;
+
+    for (size_t b = task -> from; b < task -> to; b++){
+        size_t i = b / half * len;
+        size_t j = b % half;
+        uint32_t u = a[i+j];
+        uint32_t v = montMul(a[i+j+half], w[j], &m);
+        a[i+j] = u + v >= p ? u + v - p : u + v;
+        a[i+j+half] = u >= v ? u - v : u + p - v;
+    }
+    return 0;
+}
+
+
+/* in-place forward transform of length n (a power of two);
+ * roots[half + k] holds w^k * R mod p for k < half, where w is a
+ * primitive (2 half)-th root of unity, so every stage reads its
+ * twiddle factors contiguously.
+ * With several threads, each first runs the early stages on its own
+ * contiguous chunk; the last log2(threads) stages span chunks and are
+ * split by butterfly instead. */
+static void nttTransform(uint32_t *a, size_t n, const uint32_t *roots, const NttModulus *m, int threads){
+    int count = 1;
+    if (n >= PARALLEL_THRESHOLD){
+        while (2 * count <= threads){
+            count *= 2;
+        }
+    }
+    NttTask tasks[count];
+    size_t chunk = n / count;
+
+    for (int t = 0; t < count; t++){
+        tasks[t] = (NttTask) { a, n, roots, m, t * chunk, (t + 1) * chunk, 0 };
+    }
+    nttRun(nttBitReverse, tasks, count);
+    nttRun(nttLocalStages, tasks, count);
+
+    for (size_t len = 2 * chunk; len <= n; len <<= 1){
+        size_t share = n / 2 / count;
+        for (int t = 0; t < count; t++){
+            tasks[t].from = t * share;
+            tasks[t].to = (t + 1) * share;
+            tasks[t].len = len;
+        }
+        nttRun(nttSharedStage, tasks, count);
+    }
+}
+
+
+/* fills residue with the cyclic convolution of x and y modulo one prime;
+ * scratch has room for n values */
+static void nttConvolve(uint32_t *residue, uint32_t *scratch, size_t n,
+                        const uint32_t *x, size_t nx, const uint32_t *y, size_t ny,
+                        uint32_t p, int threads){
+    NttModulus m = nttModulus(p);
+    int square = x == y && nx == ny;
+    uint32_t *roots = malloc(sizeof(uint32_t) * n);
+    assert(roots);
+
+    /* roots of unity in Montgomery form, one run per transform stage;
+     * roots[0] is unused */
+    roots[0] = 0;
+    for (size_t half = 1; half < n; half <<= 1){
+        uint32_t w = montMul(nttPow(NTT_GENERATOR, (p - 1) / (2 * half), p), m.r2, &m);
+        roots[half] = montMul(1, m.r2, &m);
+        for (size_t k = 1; k < half; k++){
+            roots[half + k] = montMul(roots[half + k - 1], w, &m);
+        }
+    }
+
+    for (size_t i = 0; i < n; i++){
+        residue[i] = i < nx ? x[i] % p : 0;
+    }
+    nttTransform(residue, n, roots, &m, threads);
+    if (square){
+        scratch = residue;
+    } else {
+        for (size_t i = 0; i < n; i++){
+            scratch[i] = i < ny ? y[i] % p : 0;
+        }
+        nttTransform(scratch, n, roots, &m, threads);
+    }
+    for (size_t i = 0; i < n; i++){
+        residue[i] = montMul(residue[i], scratch[i], &m);
+    }
+
+    /* the inverse transform is the forward one with the outputs reversed */
+    nttTransform(residue, n, roots, &m, threads);
+    for (size_t i = 1, j = n - 1; i < j; i++, j--){
+        uint32_t t = residue[i];
+        residue[i] = residue[j];
+        residue[j] = t;
+    }
+
+    /* scaling by n^-1 R^2 cancels both the n from the transform pair and
+     * the R^-1 left behind by the Montgomery pointwise products */
+    uint32_t scale = (uint64_t) nttPow(n % p, p - 2, p) * m.r2 % p;
+    for (size_t i = 0; i < n; i++){
+        residue[i] = montMul(residue[i], scale, &m);
+    }
+    free(roots);
+}
+
+
+/* arguments for running nttConvolve on its own thread */
+typedef struct nttConvolveTask {
+    uint32_t *residue;
+    uint32_t *scratch;
+    size_t n;
+    const uint32_t *x;
+    size_t nx;
+    const uint32_t *y;
+    size_t ny;
+    uint32_t p;
+    int threads;
+} NttConvolveTask;
+
+
+static void *nttConvolveThread(void *arg){
+    NttConvolveTask *task = arg;
+
+    nttConvolve(task -> residue, task -> scratch, task -> n, task -> x, task -> nx,
+                task -> y, task -> ny, task -> p, task -> threads);
+    return 0;
+}
+
+
+/* z = x * y by NTT on up to the given number of threads, where
+ * nx + ny <= NTT_MAX_LENGTH; z has room for nx + ny limbs */
+static void limbMulNtt(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny, int threads){
+    size_t n = 1;
+    while (n < nx + ny - 1){
+        n <<= 1;
+    }
+
+    /* with enough threads the primes are convolved concurrently, each with
+     * its own scratch and an equal share of the threads */
+    int concurrent = threads >= NTT_PRIMES && n >= PARALLEL_THRESHOLD;
+    int scratches = concurrent ? NTT_PRIMES : 1;
+    uint32_t *residue = malloc(sizeof(uint32_t) * n * (NTT_PRIMES + scratches));
+    assert(residue);
+    NttConvolveTask tasks[NTT_PRIMES];
+    pthread_t ids[NTT_PRIMES];
+
+    for (int k = 0; k < NTT_PRIMES; k++){
+        int share = threads / NTT_PRIMES + (k < threads % NTT_PRIMES);
+        tasks[k] = (NttConvolveTask) {
+            residue + n * k, residue + n * (NTT_PRIMES + (concurrent ? k : 0)), n,
+            x, nx, y, ny, nttPrime[k], concurrent ? share : threads
+        };
+    }
+    if (concurrent){
+        for (int k = 1; k < NTT_PRIMES; k++){
+            int error = pthread_create(&ids[k], 0, nttConvolveThread, &tasks[k]);
+            assert(error == 0);
+            (void) error;
+        }
+        nttConvolveThread(&tasks[0]);
+        for (int k = 1; k < NTT_PRIMES; k++){
+            pthread_join(ids[k], 0);
+        }
+    } else {
+        for (int k = 0; k < NTT_PRIMES; k++){
+            nttConvolveThread(&tasks[k]);
+        }
+    }
+
+    /* Garner's CRT: c = r0 + p0 t1 + p0 p1 t2 */
+    const uint64_t p0 = nttPrime[0];
+    const uint64_t p1 = nttPrime[1];
+    const uint64_t p2 = nttPrime[2];
+    const uint64_t p01 = p0 * p1;
+    const uint64_t p01Low = p01 % LIMB_BASE;
+    const uint64_t p01High = p01 / LIMB_BASE;
+    const uint64_t inv0 = nttPow(p0, p1 - 2, p1);
+    const uint64_t inv01 = nttPow(p01 % p2, p2 - 2, p2);
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < nx + ny; i++){
+        uint64_t c = carry;
+
+        if (i < nx + ny - 1){
+            uint64_t r0 = residue[i];
+            uint64_t r1 = residue[n + i];
+            uint64_t r2 = residue[2 * n + i];
+            uint64_t t1 = (r1 + p1 - r0 % p1) * inv0 % p1;
+            uint64_t low = r0 + p0 * t1;
+            uint64_t t2 = (r2 + p2 - low % p2) * inv01 % p2;
+
+            /* low < p0 p1 and p01Low * t2 < 2^59, so this cannot overflow */
+            c += low + p01Low * t2;
+            carry = c / LIMB_BASE + p01High * t2;
+        } else {
+            carry = c / LIMB_BASE;
+        }
+        z[i] = c % LIMB_BASE;
+    }
+    assert(carry == 0);
+    free(residue);
+}
+
+
+/* z = x * y, choosing the algorithm by operand size, with the transforms
+ * using up to the given number of threads;
+ * z has room for nx + ny limbs and must not overlap x or y */
+static void limbMul(uint32_t *z, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny, int threads){
+    if (nx < ny){
+        const uint32_t *swap = x;
+        size_t swapLength = nx;
+        x = y;
+        y = swap;
+        nx = ny;
+        ny = swapLength;
+    }
+
+    if (ny < KARATSUBA_THRESHOLD){
+        limbMulSchool(z, x, nx, y, ny);
+    } else if (ny >= NTT_THRESHOLD && nx + ny <= NTT_MAX_LENGTH){
+        limbMulNtt(z, x, nx, y, ny, threads);
+    } else if (ny >= TOOM3_THRESHOLD && ny > 2 * ((nx + 2) / 3)){
+        limbMulToom3(z, x, nx, y, ny, threads);
+    } else {
+        limbMulKaratsuba(z, x, nx, y, ny, threads);
+    }
+}
+
+
+/* add two Nums, returning a new Num */
+/* does not destroy its inputs, caller must destroy output */
+Num * numAdd(const Num *x, const Num *y){
+    if (x -> length < y -> length){
+        const Num *swap = x;
+        x = y;
+        y = swap;
+    }
+
+    /* the sum has at most one limb more than the longer input */
+    Num *z = numAlloc(x -> length + 1);
+    z -> a[x -> length] = limbAdd(z -> a, x -> a, x -> length, y -> a, y -> length);
+    numNormalize(z);
+    return z;
+}
+
+
+/* numMultiply with an explicit thread budget instead of numThreads */
+static Num * numMultiplyThreads(const Num *x, const Num *y, int threads){
+    Num *z = numAlloc(x -> length + y -> length);
+
+    limbMul(z -> a, x -> a, x -> length, y -> a, y -> length, threads);
+    numNormalize(z);
+    return z;
+}
+
+
+/* multiply two Nums, returning a new Num */
+/* does not destroy its inputs, caller must destroy output */
+Num * numMultiply(const Num *x, const Num *y){
+    return numMultiplyThreads(x, y, numThreads);
+}
+
+
+/* add x into dst, returning dst */
+/* dst may be reallocated if it runs out of capacity, so the caller
+ * must use the returned pointer, as with realloc: dst = numAddInto(dst, x);
+ * x may be dst itself */
+Num * numAddInto(Num *dst, const Num *x){
+    int self = x == dst;
+    size_t length = (dst -> length > x -> length ? dst -> length : x -> length) + 1;
+
+    dst = numReserve(dst, length);
+    if (self){
+        x = dst;
+    }
+    numExtend(dst, length);
+    limbAdd(dst -> a, dst -> a, length, x -> a, x -> length);
+    numNormalize(dst);
+    return dst;
+}
+
+
+/* add the product x * y into dst, returning dst */
+/* dst may be reallocated as in numAddInto; x and y may be dst itself */
+Num * numMulAddInto(Num *dst, const Num *x, const Num *y){
+    size_t nx = x -> length;
+    size_t ny = y -> length;
+    size_t length = (dst -> length > nx + ny ? dst -> length : nx + ny) + 1;
+
+    if ((nx == 1 && x -> a[0] == 0) || (ny == 1 && y -> a[0] == 0)){
+        return dst;
+    }
+
+    if ((nx < KARATSUBA_THRESHOLD || ny < KARATSUBA_THRESHOLD) && x != dst && y != dst){
+        /* short operand: accumulate the rows straight into dst */
+        dst = numReserve(dst, length);
+        numExtend(dst, length);
+        limbMulAddSchool(dst -> a, length, x -> a, nx, y -> a, ny);
+    } else {
+        uint32_t *product = malloc(sizeof(uint32_t) * (nx + ny));
+        assert(product);
+        limbMul(product, x -> a, nx, y -> a, ny, numThreads);
+        dst = numReserve(dst, length);
+        numExtend(dst, length);
+        limbAdd(dst -> a, dst -> a, length, product, limbLength(product, nx + ny));
+        free(product);
+    }
+    numNormalize(dst);
+    return dst;
+}
+
+
+/* Division.
+ * Short divisors use schoolbook long division (Knuth's algorithm D).
+ * Long divisors use a reciprocal computed by Newton iteration on top of
+ * the fast multiply, after which each division step is a Barrett
+ * reduction: two multiplications and at most two corrections. */
+
+/* q = x / d for a single limb d, returning the remainder; q may alias x */
+static uint32_t limbDivSmall(uint32_t *q, const uint32_t *x, size_t n, uint32_t d){
+    uint64_t remainder = 0;
+
+    for (size_t i = n; i-- > 0;){
+        uint64_t t = remainder * LIMB_BASE + x[i];
+        q[i] = t / d;
+        remainder = t % d;
+    }
+    return remainder;
+}
+
+
+/* q = x / y and r = x % y by long division, where nx >= ny and y has no
+ * leading zero limb; q has room for nx - ny + 1 limbs and r for ny */
+static void limbDivSchool(uint32_t *q, uint32_t *r, const uint32_t *x, size_t nx, const uint32_t *y, size_t ny){
+    if (ny == 1){
+        r[0] = limbDivSmall(q, x, nx, y[0]);
+        return;
+    }
+
+    /* scale so the top limb of the divisor is at least LIMB_BASE / 2,
+     * which keeps every quotient estimate within 2 of the true limb */
+    uint32_t f = LIMB_BASE / (y[ny-1] + 1);
+    uint32_t *u = malloc(sizeof(uint32_t) * (nx + 1 + ny));
+    assert(u);
+    uint32_t *v = u + nx + 1;
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < nx; i++){
+        uint64_t t = (uint64_t) x[i] * f + carry;
+        u[i] = t % LIMB_BASE;
+        carry = t / LIMB_BASE;
+    }
+    u[nx] = carry;
+    carry = 0;
+    for (size_t i = 0; i < ny; i++){
+        uint64_t t = (uint64_t) y[i] * f + carry;
+        v[i] = t % LIMB_BASE;
+        carry = t / LIMB_BASE;
+    }
+
+    for (size_t j = nx - ny + 1; j-- > 0;){
+        uint64_t top = (uint64_t) u[j+ny] * LIMB_BASE + u[j+ny-1];
+        uint64_t qhat = top / v[ny-1];
+        uint64_t rhat = top % v[ny-1];
+
+        while (qhat >= LIMB_BASE || qhat * v[ny-2] > rhat * LIMB_BASE + u[j+ny-2]){
+            qhat--;
+            rhat += v[ny-1];
+            if (rhat >= LIMB_BASE){
+                break;
+            }
+        }
+
+        /* u[j..j+ny] -= qhat * v */
+        int64_t borrow = 0;
+        carry = 0;
+        for (size_t i = 0; i < ny; i++){
+            uint64_t p = qhat * v[i] + carry;
+            carry = p / LIMB_BASE;
+            int64_t t = (int64_t) u[i+j] - (int64_t) (p % LIMB_BASE) - borrow;
+            borrow = t < 0;
+            u[i+j] = t < 0 ? t + LIMB_BASE : t;
+        }
+        int64_t t = (int64_t) u[j+ny] - (int64_t) carry - borrow;
+
+        if (t < 0){
+            /* qhat was one too large: add v back */
+            uint32_t c = 0;
+            qhat--;
+            for (size_t i = 0; i < ny; i++){
+                uint32_t sum = u[i+j] + v[i] + c;
+                c = sum >= LIMB_BASE;
+                u[i+j] = c ? sum - LIMB_BASE : sum;
+            }
+            t = 0;
+        }
+        u[j+ny] = t;
+        q[j] = qhat;
+    }
+
+    limbDivSmall(r, u, ny, f);
+    free(u);
+}
+
+
+/* returns a copy of x */
+static Num * numCopy(const Num *x){
+    return numFromLimbs(x -> a, x -> length);
+}
+
+
+static int numIsZero(const Num *x){
+    return x -> length == 1 && x -> a[0] == 0;
+}
+
+
+/* returns -1, 0 or 1 as x is less than, equal to or greater than y */
+static int numCompare(const Num *x, const Num *y){
+    return limbCompare(x -> a, x -> length, y -> a, y -> length);
+}
+
+
+/* x -= y in place, where x >= y */
+static void numSubInPlace(Num *x, const Num *y){
+    limbSub(x -> a, x -> a, x -> length, y -> a, y -> length);
+    numNormalize(x);
+}
+
+
+/* returns x / B^k, rounded down */
+static Num * numShiftDown(const Num *x, size_t k){
+    if (k >= x -> length){
+        return numFromLimbs(x -> a, 0);
+    }
+    return numFromLimbs(x -> a + k, x -> length - k);
+}
+
+
+/* returns x * B^k */
+static Num * numShiftUp(const Num *x, size_t k){
+    Num *z;
+
+    if (numIsZero(x)){
+        return numCopy(x);
+    }
+    z = numAlloc(x -> length + k);
+    memset(z -> a, 0, sizeof(uint32_t) * k);
+    memcpy(z -> a + k, x -> a, sizeof(uint32_t) * x -> length);
+    return z;
+}
+
+
+/* returns B^k */
+static Num * numPowerOfBase(size_t k){
+    Num *z = numAlloc(k + 1);
+
+    memset(z -> a, 0, sizeof(uint32_t) * k);
+    z -> a[k] = 1;
+    return z;
+}
+
+
+/* returns a one-limb Num */
+static Num * numSmall(uint32_t value){
+    return numFromLimbs(&value, 1);
+}
+
+
+/* returns floor(B^(2n) / y), where y has n limbs */
+static Num * numReciprocal(const Num *y){
+    size_t n = y -> length;
+    Num *power = numPowerOfBase(2 * n);
+    Num *v;
+
+    if (n < NEWTON_THRESHOLD){
+        v = numAlloc(n + 2);
+        Num *r = numAlloc(n);
+        limbDivSchool(v -> a, r -> a, power -> a, power -> length, y -> a, n);
+        numNormalize(v);
+        numDestroy(r);
+        numDestroy(power);
+        return v;
+    }
+
+    /* the reciprocal of the top half of y, scaled up, is right to about
+     * half the limbs; Newton steps v += v (B^2n - y v) / B^2n double that
+     * each time until v lands on the exact floor, where 0 <= B^2n - y v < y */
+    size_t h = (n + 1) / 2;
+    Num *high = numShiftDown(y, n - h);
+    Num *vh = numReciprocal(high);
+    v = numShiftUp(vh, n - h);
+    numDestroy(high);
+    numDestroy(vh);
+
+    for (;;){
+        Num *product = numMultiply(y, v);
+        Num *error;
+        int over = numCompare(product, power) > 0;
+
+        if (over){
+            error = product;
+            numSubInPlace(error, power);
+        } else {
+            error = numCopy(power);
+            numSubInPlace(error, product);
+            numDestroy(product);
+            if (numCompare(error, y) < 0){
+                numDestroy(error);
+                break;
+            }
+        }
+
+        /* truncation can round the step to 0 near the end; move by at least 1 */
+        Num *scaled = numMultiply(v, error);
+        Num *correction = numShiftDown(scaled, 2 * n);
+        numDestroy(scaled);
+        numDestroy(error);
+        if (numIsZero(correction) || over){
+            Num *one = numSmall(1);
+            correction = numAddInto(correction, one);
+            numDestroy(one);
+        }
+        if (over){
+            numSubInPlace(v, correction);
+        } else {
+            v = numAddInto(v, correction);
+        }
+        numDestroy(correction);
+    }
+    numDestroy(power);
+    return v;
+}
+
+
+/* Barrett reduction of x < B^(2k) modulo m, where m has k limbs and
+ * mu = floor(B^(2k) / m).  Returns x % m and sets *q to x / m unless q is 0. */
+static Num * numBarrett(const Num *x, const Num *m, const Num *mu, Num **q){
+    size_t k = m -> length;
+    Num *high = numShiftDown(x, k - 1);
+    Num *product = numMultiply(high, mu);
+    Num *quotient = numShiftDown(product, k + 1);
+    numDestroy(high);
+    numDestroy(product);
+
+    /* the estimate is at most two below the true quotient */
+    Num *r = numCopy(x);
+    product = numMultiply(quotient, m);
+    numSubInPlace(r, product);
+    numDestroy(product);
+    while (numCompare(r, m) >= 0){
+        Num *one = numSmall(1);
+        numSubInPlace(r, m);
+        quotient = numAddInto(quotient, one);
+        numDestroy(one);
+    }
+
+    if (q){
+        *q = quotient;
+    } else {
+        numDestroy(quotient);
+    }
+    return r;
+}
+
+
+/* Divide x by y, storing the quotient in *q and the remainder in *r.
+ * Either of q and r may be 0 if that result is not wanted.
+ * Returns 0 without touching *q or *r if y is zero, 1 otherwise.
+ * Caller must destroy the outputs. */
+int numDivMod(const Num *x, const Num *y, Num **q, Num **r){
+    size_t nx = x -> length;
+    size_t ny = y -> length;
+    Num *quotient;
+    Num *remainder;
+
+    if (numIsZero(y)){
+        return 0;
+    }
+
+    if (numCompare(x, y) < 0){
+        quotient = numSmall(0);
+        remainder = numCopy(x);
+    } else if (ny < NEWTON_THRESHOLD){
+        quotient = numAlloc(nx - ny + 1);
+        remainder = numAlloc(ny);
+        limbDivSchool(quotient -> a, remainder -> a, x -> a, nx, y -> a, ny);
+        numNormalize(quotient);
+        numNormalize(remainder);
+    } else {
+        /* divide ny limbs at a time from the top, carrying the remainder
+         * into the next block, so each step is a 2n-by-n division */
+        Num *mu = numReciprocal(y);
+        size_t blocks = (nx + ny - 1) / ny;
+
+        quotient = numAlloc(blocks * ny);
+        memset(quotient -> a, 0, sizeof(uint32_t) * blocks * ny);
+        remainder = numSmall(0);
+        for (size_t b = blocks; b-- > 0;){
+            size_t low = b * ny;
+            size_t high = low + ny < nx ? low + ny : nx;
+            Num *step = numAlloc(high - low + remainder -> length);
+            Num *qb;
+
+            memcpy(step -> a, x -> a + low, sizeof(uint32_t) * (high - low));
+            memcpy(step -> a + high - low, remainder -> a, sizeof(uint32_t) * remainder -> length);
+            numNormalize(step);
+            numDestroy(remainder);
+            remainder = numBarrett(step, y, mu, &qb);
+            memcpy(quotient -> a + low, qb -> a, sizeof(uint32_t) * qb -> length);
+            numDestroy(qb);
+            numDestroy(step);
+        }
+        numNormalize(quotient);
+        numDestroy(mu);
+    }
+
+    if (q){
+        *q = quotient;
+    } else {
+        numDestroy(quotient);
+    }
+    if (r){
+        *r = remainder;
+    } else {
+        numDestroy(remainder);
+    }
+    return 1;
+}
+
+
+/* returns x * y % m by Barrett reduction, destroying x */
+static Num * numMulMod(Num *x, const Num *y, const Num *m, const Num *mu){
+    Num *product = numMultiply(x, y);
+    Num *r = numBarrett(product, m, mu, 0);
+
+    numDestroy(product);
+    numDestroy(x);
+    return r;
+}
+
+
+/* Compute base^exponent % modulus, returning a new Num.
+ * Returns 0 if modulus is zero.  0^0 is 1 (reduced modulo modulus).
+ * Works through the exponent one decimal digit at a time:
+ * r = r^10 * base^digit, with base^0 .. base^9 computed up front,
+ * and every product reduced by Barrett reduction. */
+Num * numPowMod(const Num *base, const Num *exponent, const Num *modulus){
+    Num *power[10];
+    Num *mu;
+    Num *result;
+
+    if (numIsZero(modulus)){
+        return 0;
+    }
+    mu = numReciprocal(modulus);
+    power[0] = numSmall(1);
+    numDivMod(base, modulus, 0, &power[1]);
+    for (int d = 2; d < 10; d++){
+        power[d] = numMulMod(numCopy(power[d-1]), power[1], modulus, mu);
+    }
+
+    result = numBarrett(power[0], modulus, mu, 0);
+    for (int i = exponent -> length * LIMB_DIGITS - 1; i >= 0; i--){
+        int digit = numGetDigit(exponent, i);
+        if (!numIsZero(result) && !(result -> length == 1 && result -> a[0] == 1)){
+            /* r^10 = (r^4 r)^2 */
+            Num *square = numMulMod(numCopy(result), result, modulus, mu);
+            Num *fourth = numMulMod(square, square, modulus, mu);
+            Num *fifth = numMulMod(fourth, result, modulus, mu);
+            numDestroy(result);
+            result = numMulMod(fifth, fifth, modulus, mu);
+        }
+        if (digit != 0){
+            result = numMulMod(result, power[digit], modulus, mu);
+        }
+    }
+
+    for (int d = 0; d < 10; d++){
+        numDestroy(power[d]);
+    }
+    numDestroy(mu);
+    return result;
+}
+
+
+/* products whose factors total fewer limbs than this are never split across threads */
+#define PRODUCT_PARALLEL_THRESHOLD (1 << 12)
+
+/* a range of factors for productRange, runnable on its own thread */
+typedef struct productTask {
+    const Num **xs;
+    const size_t *prefix;   /* prefix[i] = total limbs of xs[0 .. i) */
+    size_t lo;
+    size_t hi;
+    int threads;
+    Num *result;
+} ProductTask;
+
+
+/* multiplies xs[lo .. hi) as a product tree split where the limbs balance,
+ * so each multiplication sees operands of similar size */
+static void *productRange(void *arg){
+    ProductTask *task = arg;
+    size_t lo = task -> lo;
+    size_t hi = task -> hi;
+
+    if (hi - lo == 1){
+        task -> result = numCopy(task -> xs[lo]);
+        return 0;
+    }
+
+    size_t half = (task -> prefix[lo] + task -> prefix[hi]) / 2;
+    size_t mid = lo + 1;
+    while (mid < hi - 1 && task -> prefix[mid] < half){
+        mid++;
+    }
+
+    /* halves run one after the other keep the whole budget; only halves
+     * running side by side split it */
+    int parallel = task -> threads > 1 && task -> prefix[hi] - task -> prefix[lo] >= PRODUCT_PARALLEL_THRESHOLD;
+    ProductTask left = { task -> xs, task -> prefix, lo, mid, task -> threads, 0 };
+    ProductTask right = { task -> xs, task -> prefix, mid, hi, task -> threads, 0 };
+    pthread_t thread;
+
+    if (parallel){
+        left.threads = task -> threads / 2;
+        right.threads = task -> threads - left.threads;
+    }
+    if (parallel && pthread_create(&thread, 0, productRange, &left) == 0){
+        productRange(&right);
+        pthread_join(thread, 0);
+    } else {
+        /* sequential after all, possibly because the thread could not start */
+        left.threads = task -> threads;
+        right.threads = task -> threads;
+        productRange(&left);
+        productRange(&right);
+    }
+    task -> result = numMultiplyThreads(left.result, right.result, task -> threads);
+    numDestroy(left.result);
+    numDestroy(right.result);
+    return 0;
+}
+
+
+/* Multiply k Nums together, returning a new Num (1 if k is 0).
+ * Builds a balanced product tree, so this costs a few large balanced
+ * multiplications rather than k ever more lopsided ones.  With
+ * numSetThreads above 1, independent subtrees run on separate threads,
+ * and each multiplication uses only its own subtree's share of them.
+ * Does not destroy its inputs, caller must destroy output */
+Num * numProductMany(const Num **xs, size_t k){
+    size_t *prefix;
+    ProductTask task;
+
+    if (k == 0){
+        return numSmall(1);
+    }
+    prefix = malloc(sizeof(size_t) * (k + 1));
+    assert(prefix);
+    prefix[0] = 0;
+    for (size_t i = 0; i < k; i++){
+        prefix[i+1] = prefix[i] + xs[i] -> length;
+    }
+
+    task = (ProductTask) { xs, prefix, 0, k, numThreads, 0 };
+    productRange(&task);
+    free(prefix);
+    return task.result;
+}
+
+
+/* number of digits in a Num, without leading zeros */
+static size_t numDigits(const Num *n){
+    size_t digits = (n -> length - 1) * (size_t) LIMB_DIGITS + 1;
+
+    for (uint32_t top = n -> a[n -> length - 1]; top >= 10; top /= 10){
+        digits++;
+    }
+    return digits;
+}
+
+
+/* writes the nine digits of a limb, zero-padded, to out */
+static void limbFormat(char *out, uint32_t limb){
+    for (int i = LIMB_DIGITS - 1; i >= 0; i--){
+        out[i] = '0' + limb % 10;
+        limb /= 10;
+    }
+}
+
+
+/* Return the digits of a number as a new NUL-terminated string,
+ * without leading zeros unless n is zero.
+ * Stores the number of digits in *length if length is not 0.
+ * Caller must free the string.
+ * Limbs are base 10^9, so conversion is a single linear pass. */
+char * numToString(const Num *n, size_t *length){
+    size_t digits = numDigits(n);
+    char *s = malloc(digits + 1);
+    size_t top = digits - (n -> length - 1) * (size_t) LIMB_DIGITS;
+    char first[LIMB_DIGITS];
+
+    assert(s);
+    /* most significant limb without padding, the rest zero-filled */
+    limbFormat(first, n -> a[n -> length - 1]);
+    memcpy(s, first + LIMB_DIGITS - top, top);
+    for (size_t i = 1; i < n -> length; i++){
+        limbFormat(s + top + (i - 1) * LIMB_DIGITS, n -> a[n -> length - 1 - i]);
+    }
+    s[digits] = '\0';
+    if (length){
+        *length = digits;
+    }
+    return s;
+}
+
+
+/* bytes of digits numPrint formats before each write */
+#define PRINT_BUFFER (1 << 16)
+
+/* Print the digits of a number to file.
+ * Do not print any leading zeros unless n is zero. */
+void numPrint(const Num *n, FILE *f){
+    char buffer[PRINT_BUFFER];
+    size_t used;
+    char first[LIMB_DIGITS];
+    size_t top = numDigits(n) - (n -> length - 1) * (size_t) LIMB_DIGITS;
+
+    /* format whole limbs into a buffer, writing it out only when full */
+    limbFormat(first, n -> a[n -> length - 1]);
+    memcpy(buffer, first + LIMB_DIGITS - top, top);
+    used = top;
+    for (size_t i = n -> length - 1; i-- > 0;){
+        if (used + LIMB_DIGITS > PRINT_BUFFER){
+            fwrite(buffer, 1, used, f);
+            used = 0;
+        }
+        limbFormat(buffer + used, n -> a[i]);
+        used += LIMB_DIGITS;
+    }
+    fwrite(buffer, 1, used, f);
+}
+
+
+/* returns a new Num holding a 64-bit value */
+static Num * numFromUint64(uint64_t value){
+    Num *number = numAlloc(3);
+
+    for (size_t i = 0; i < 3; i++){
+        number -> a[i] = value % LIMB_BASE;
+        value /= LIMB_BASE;
+    }
+    numNormalize(number);
+    return number;
+}
+
+
+/* Small-value arithmetic.
+ * The NumValue functions work on native integers until a result
+ * overflows 64 bits, then promote it to a Num and continue with the
+ * big-number routines.  Results are new values that the caller must
+ * release with numValueDestroy; inputs are never destroyed. */
+
+/* Make a NumValue from a native integer; never allocates */
+NumValue numValueFromInt(uint64_t value){
+    NumValue v = { value, 0 };
+    return v;
+}
+
+
+/* Make a NumValue from a Num, keeping it small when it fits in 64 bits */
+NumValue numValueFromNum(const Num *n){
+    NumValue v = { 0, 0 };
+
+    if (n -> length <= 3){
+        const uint64_t limb2 = (uint64_t) LIMB_BASE * LIMB_BASE;
+        uint64_t high = n -> length == 3 ? n -> a[2] : 0;
+        uint64_t low = (n -> length >= 2 ? (uint64_t) n -> a[1] * LIMB_BASE : 0) + n -> a[0];
+
+        /* fits when high * 10^18 + low <= 2^64 - 1 */
+        if (high <= UINT64_MAX / limb2 && low <= UINT64_MAX - high * limb2){
+            v.small = high * limb2 + low;
+            return v;
+        }
+    }
+    v.big = numCopy(n);
+    return v;
+}
+
+
+/* Return a NumValue as a new Num; caller must destroy it */
+Num * numValueToNum(NumValue v){
+    return v.big ? numCopy(v.big) : numFromUint64(v.small);
+}
+
+
+/* Release a NumValue; free for small values */
+void numValueDestroy(NumValue v){
+    if (v.big){
+        numDestroy(v.big);
+    }
+}
+
+
+/* applies a big-number operation to two NumValues, promoting either as needed */
+static NumValue numValueBig(NumValue x, NumValue y, Num * (*op)(const Num *, const Num *)){
+    Num *bx = x.big ? x.big : numFromUint64(x.small);
+    Num *by = y.big ? y.big : numFromUint64(y.small);
+    NumValue z = { 0, op(bx, by) };
+
+    if (!x.big){
+        numDestroy(bx);
+    }
+    if (!y.big){
+        numDestroy(by);
+    }
+    return z;
+}
+
+
+/* add two NumValues */
+NumValue numValueAdd(NumValue x, NumValue y){
+    if (!x.big && !y.big && x.small + y.small >= x.small){
+        return numValueFromInt(x.small + y.small);
+    }
+    return numValueBig(x, y, numAdd);
+}
+
+
+/* multiply two NumValues */
+NumValue numValueMultiply(NumValue x, NumValue y){
+    if (!x.big && !y.big){
+        uint64_t product;
+#ifdef __GNUC__
+        if (!__builtin_mul_overflow(x.small, y.small, &product)){
+            return numValueFromInt(product);
+        }
+#else
+        product = x.small * y.small;
+        if (x.small == 0 || product / x.small == y.small){
+            return numValueFromInt(product);
+        }
+#endif
+    }
+    return numValueBig(x, y, numMultiply);
+}
+
+
+/* Print a NumValue to file, like numPrint */
+void numValuePrint(NumValue v, FILE *f){
+    if (v.big){
+        numPrint(v.big, f);
+    } else {
+        fprintf(f, "%" PRIu64, v.small);
+    }
+}
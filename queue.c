@@ -1,68 +1,152 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <assert.h>
-
-typedef struct elt {
-    char *string;
-    struct elt *next;
-} Elt;
-
-typedef struct queue {
-    struct elt *head;
-    struct elt *tail;
-    int n;
-} Queue;
-
-Queue * queueCreate(void){
-    Queue *q;
-    q = malloc(sizeof(Queue));
-    q->head = 0;
-    q->tail = 0;
-    q->n = 0;
-    return q;
-}
-
-void enqueue(char *a, Queue *q){
-    Elt *e = malloc(sizeof(Elt));
-    e->next = 0;
-
-    int length = strlen(a);
-    e->string = malloc(length+1);
-    strcpy(e->string, a);
-
-    if (q->n == 0){
-        q->head = q->tail = e;
-    } else {
-        q->tail->next = e;
-        q->tail = e;
-    }
-
-    q->n++;
-}
-
-Elt * dequeue(Queue *q){
-    Elt *e1 = q->head;
-    q->head = e1->next;
-    q->n--;
-    return e1;
-}
-
-int queueEmpty(Queue *q){
-    return(q->n == 0);
-}
-
-int main(int argc, char **argv){
-    Queue *q = queueCreate();
-    for(int i = 1; i < argc; i++){
-        enqueue(argv[i], q);
-    }
-
-    while(!queueEmpty(q)){
-        Elt *e = dequeue(q);
-        printf("%s\n", e->string);
-        free(e->string);
-        free(e);
-    }
-    free(q);
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define INITIAL_CAPACITY (16)
+#define CHUNK_SIZE (1 << 16)
+
+// block of copied strings, handed out by bumping used
+struct chunk {
+    struct chunk *next;
+    size_t pending;     // strings in it not yet dequeued
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+// queued string, and the chunk holding it if it was copied
+typedef struct slot {
+    char *string;
+    struct chunk *chunk;
+} Slot;
+
+// ring buffer of slots; copies live in a list of chunks, oldest first
+typedef struct queue {
+    Slot *slot;
+    size_t capacity;    // a power of two
+    size_t head;
+    size_t n;
+    struct chunk *oldest;
+    struct chunk *newest;
+} Queue;
+
+Queue * queueCreate(void){
+    Queue *q;
+    q = malloc(sizeof(Queue));
+    assert(q);
+    q->capacity = INITIAL_CAPACITY;
+    q->slot = malloc(q->capacity * sizeof(Slot));
+    assert(q->slot);
+    q->head = 0;
+    q->n = 0;
+    q->oldest = 0;
+    q->newest = 0;
+    return q;
+}
+
+void queueDestroy(Queue *q){
+    struct chunk *c;
+    struct chunk *next;
+    for(c = q->oldest; c != 0; c = next){
+        next = c->next;
+        free(c);
+    }
+    free(q->slot);
+    free(q);
+}
+
+static void queuePush(Queue *q, char *string, struct chunk *chunk){
+    if (q->n == q->capacity){
+        // double, moving the wrapped-around front to the new space
+        q->slot = realloc(q->slot, 2 * q->capacity * sizeof(Slot));
+        assert(q->slot);
+        memcpy(q->slot + q->capacity, q->slot, q->head * sizeof(Slot));
+        q->capacity *= 2;
+    }
+
+    Slot *s = &q->slot[(q->head + q->n) & (q->capacity - 1)];
+    s->string = string;
+    s->chunk = chunk;
+    q->n++;
+}
+
+// room for length bytes in the newest chunk, reusing chunks whose
+// strings have all been dequeued before allocating another
+static char * queueReserve(Queue *q, size_t length){
+    struct chunk *c = q->newest;
+    if (c != 0 && c->pending == 0){
+        c->used = 0;
+    }
+    if (c != 0 && c->capacity - c->used >= length){
+        return c->data + c->used;
+    }
+
+    c = q->oldest;
+    if (c != 0 && c != q->newest && c->pending == 0 && c->capacity >= length){
+        q->oldest = c->next;
+    } else {
+        size_t capacity = length > CHUNK_SIZE ? length : CHUNK_SIZE;
+        c = malloc(sizeof(struct chunk) + capacity);
+        assert(c);
+        c->capacity = capacity;
+    }
+    c->next = 0;
+    c->pending = 0;
+    c->used = 0;
+
+    if (q->newest == 0){
+        q->oldest = c;
+    } else {
+        q->newest->next = c;
+    }
+    q->newest = c;
+    return c->data;
+}
+
+// Add a copy of a to the back of q.
+void enqueue(char *a, Queue *q){
+    size_t length = strlen(a) + 1;
+    char *copy = queueReserve(q, length);
+    memcpy(copy, a, length);
+    q->newest->used += length;
+    q->newest->pending++;
+    queuePush(q, copy, q->newest);
+}
+
+// Add a itself to the back of q, without copying it; a must stay valid
+// until it has been dequeued, as argv strings do.
+void enqueueBorrowed(char *a, Queue *q){
+    queuePush(q, a, 0);
+}
+
+// Remove and return the string at the front of q, or 0 if q is empty.
+// A copied string stays valid until the next enqueue or queueDestroy.
+char * dequeue(Queue *q){
+    if (q->n == 0){
+        return 0;
+    }
+    Slot *s = &q->slot[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->n--;
+    if (s->chunk != 0){
+        s->chunk->pending--;
+    }
+    return s->string;
+}
+
+int queueEmpty(Queue *q){
+    return(q->n == 0);
+}
+
+int main(int argc, char **argv){
+    Queue *q = queueCreate();
+    for(int i = 1; i < argc; i++){
+        enqueueBorrowed(argv[i], q);
+    }
+
+    while(!queueEmpty(q)){
+        printf("%s\n", dequeue(q));
+    }
+    queueDestroy(q);
+}
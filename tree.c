@@ -1,65 +1,407 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <assert.h>
-
-#define LEFT (0)
-#define RIGHT (1)
-#define NUM_CHILDREN (2)
-
-
-typedef struct node{
-    int value;
-    struct node * children[NUM_CHILDREN];
-} Node;
-
-
-Node * treeCreate (Node *t, int n){
-    Node *t1 = malloc(sizeof(Node));
-    t1->value = n;
-
-    if (n == 1){
-        t1->children[LEFT] = 0;
-        t1->children[RIGHT] = 0;
-        return t1;
-    } else{
-        t1->children[LEFT] = treeCreate(t1->children[LEFT], n-n/2);
-        t1->children[RIGHT] = treeCreate(t1->children[RIGHT], n/2);
-    }
-    return t1;
-}
-
-
-void treeDestroy (Node *n){
-    if (n == 0){
-        return;
-    } else {
-        treeDestroy(n->children[LEFT]);
-        treeDestroy(n->children[RIGHT]);
-        free(n);
-    }
-}
-
-
-void treePrint (Node * n){
-    if(n == 0){
-        return;
-    } else {
-        treePrint(n->children[LEFT]);
-        for(int i = 0; i < n->value; i++){
-            printf(" ");
-        }
-        printf("%i\n", n->value);
-        treePrint(n->children[RIGHT]);
-    }
-}
-
-
-int main(int argc, char **argv){
-    if (argc != 2 || !atoi(argv[1]) || atoi(argv[1]) < 1){
-        fprintf(stderr, "Usage: ./tree [size]\n");
-        exit(1);
-    }
-    Node *t = treeCreate(0, atoi(argv[1]));
-    treePrint(t);
-    treeDestroy(t);
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+
+#define LEFT (0)
+#define RIGHT (1)
+#define NUM_CHILDREN (2)
+
+// largest size whose 2n-1 nodes still have 32-bit indices
+#define MAX_SIZE ((size_t) 1 << 31)
+
+// largest size -s and -j accept; the output is then about 45 TB, and
+// its length still fits in a size_t with room to spare
+#define MAX_STREAM_SIZE ((size_t) 1 << 40)
+
+// bytes collected by treeStream before each write
+#define OUTPUT_BUFFER_SIZE ((size_t) 1 << 22)
+
+// digits in the largest size_t, plus the newline
+#define MAX_LINE_TAIL (21)
+
+// treeParallel splits the output into pieces of at most this many bytes,
+// and renders at most PIECES_PER_THREAD of them per thread per write,
+// but no more than MAX_BATCH_PIECES in all (256 MB)
+#define PIECE_SIZE OUTPUT_BUFFER_SIZE
+#define PIECES_PER_THREAD (4)
+#define MAX_BATCH_PIECES (64)
+
+// most threads -j accepts
+#define MAX_THREADS (256)
+
+
+// Nodes live in one arena in breadth-first order, node 0 being the root.
+// A leaf has no children (both indices 0, which is never a child); a
+// node's value is its subtree size, which the walk down from the root
+// carries along instead of storing.
+typedef struct node{
+    uint32_t children[NUM_CHILDREN];
+} Node;
+
+
+// Build the tree of size n, 1 <= n <= MAX_SIZE, without recursion and
+// with a single allocation of 2n-1 nodes.
+Node * treeCreate (size_t n){
+    size_t count = 2*n - 1;
+    Node *t = malloc(count * sizeof(Node));
+    assert(t);
+
+    // a node that has not been expanded yet keeps its size in children[LEFT];
+    // the nodes are expanded in order, each appending its two children
+    t[0].children[LEFT] = n;
+    size_t next = 1;
+    for (size_t i = 0; i < count; i++){
+        size_t size = t[i].children[LEFT];
+        if (size == 1){
+            t[i].children[LEFT] = 0;
+            t[i].children[RIGHT] = 0;
+        } else {
+            t[next].children[LEFT] = size - size/2;
+            t[next + 1].children[LEFT] = size/2;
+            t[i].children[LEFT] = next;
+            t[i].children[RIGHT] = next + 1;
+            next += 2;
+        }
+    }
+    return t;
+}
+
+
+void treeDestroy (Node *t){
+    free(t);
+}
+
+
+// print the subtree at node i, which has the given size
+void treePrint (const Node *t, size_t i, size_t size){
+    if (t[i].children[LEFT] != 0){
+        treePrint(t, t[i].children[LEFT], size - size/2);
+    }
+    for(size_t j = 0; j < size; j++){
+        printf(" ");
+    }
+    printf("%zu\n", size);
+    if (t[i].children[RIGHT] != 0){
+        treePrint(t, t[i].children[RIGHT], size/2);
+    }
+}
+
+
+// Output buffer that is written to fd whenever it fills up.
+typedef struct output{
+    int fd;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+} Output;
+
+
+void outputFlush (Output *o){
+    for(size_t done = 0; done < o->length; ){
+        ssize_t written = write(o->fd, o->buffer + done, o->length - done);
+        if (written < 0 && errno == EINTR){
+            continue;
+        } else if (written <= 0){
+            perror("write");
+            exit(1);
+        }
+        done += written;
+    }
+    o->length = 0;
+}
+
+
+// append count spaces, a buffer's worth at a time
+void outputSpaces (Output *o, size_t count){
+    while(count > 0){
+        if (o->length == o->capacity){
+            outputFlush(o);
+        }
+        size_t run = o->capacity - o->length < count ? o->capacity - o->length : count;
+        memset(o->buffer + o->length, ' ', run);
+        o->length += run;
+        count -= run;
+    }
+}
+
+
+// append the line treePrint prints for a node of the given size
+void outputLine (Output *o, size_t size){
+    outputSpaces(o, size);
+
+    char digits[MAX_LINE_TAIL];
+    int k = 0;
+    do {
+        digits[k++] = '0' + size % 10;
+        size /= 10;
+    } while(size > 0);
+
+    // only flush when needed, so an exactly sized buffer never is
+    if (o->capacity - o->length < (size_t) k + 1){
+        outputFlush(o);
+    }
+    while(k > 0){
+        o->buffer[o->length++] = digits[--k];
+    }
+    o->buffer[o->length++] = '\n';
+}
+
+
+// Append what treePrint prints for the tree of size n, without building
+// the tree: the in-order walk only needs the sizes, which an explicit
+// stack of O(log n) entries provides.
+void treeRender (Output *o, size_t n){
+    // sizes of the nodes whose left subtree is being printed
+    size_t stack[8 * sizeof(size_t)];
+    size_t top = 0;
+    size_t size = n;
+    for(;;){
+        while(size > 1){
+            stack[top++] = size;
+            size = size - size/2;
+        }
+        outputLine(o, size);
+        if (top == 0){
+            break;
+        }
+        size = stack[--top];
+        outputLine(o, size);
+        size = size/2;
+    }
+}
+
+
+// write what treePrint prints for the tree of size n to fd
+void treeStream (size_t n, int fd){
+    Output o = { fd, malloc(OUTPUT_BUFFER_SIZE), 0, OUTPUT_BUFFER_SIZE };
+    assert(o.buffer);
+    treeRender(&o, n);
+    outputFlush(&o);
+    free(o.buffer);
+}
+
+
+// subtree sizes and their output lengths seen so far by treeLength
+typedef struct lengthMemo{
+    size_t count;
+    size_t size[2 * 8 * sizeof(size_t)];
+    size_t length[2 * 8 * sizeof(size_t)];
+} LengthMemo;
+
+
+// bytes in the line for a node of the given size
+size_t lineLength (size_t size){
+    size_t digits = 1;
+    for(size_t rest = size; rest >= 10; rest /= 10){
+        digits++;
+    }
+    return size + digits + 1;
+}
+
+
+// Bytes treeRender produces for the tree of size n.  The subtrees at any
+// one depth have at most two distinct sizes, so with the memo this takes
+// O(log n) steps rather than one per node.
+size_t treeLength (size_t n, LengthMemo *memo){
+    if (n == 1){
+        return lineLength(1);
+    }
+    for(size_t i = 0; i < memo->count; i++){
+        if (memo->size[i] == n){
+            return memo->length[i];
+        }
+    }
+    size_t length = treeLength(n - n/2, memo) + lineLength(n) + treeLength(n/2, memo);
+    assert(memo->count < sizeof(memo->size) / sizeof(memo->size[0]));
+    memo->size[memo->count] = n;
+    memo->length[memo->count] = length;
+    memo->count++;
+    return length;
+}
+
+
+// One piece of the output: a whole subtree, or the line of a single node
+// whose subtrees are pieces of their own.
+typedef struct piece{
+    size_t size;
+    int line;
+    size_t length;
+} Piece;
+
+
+// Pieces list, grown as needed.
+typedef struct pieces{
+    Piece *piece;
+    size_t count;
+    size_t capacity;
+} Pieces;
+
+
+void piecesAdd (Pieces *p, size_t size, int line, size_t length){
+    if (p->count == p->capacity){
+        p->capacity = p->capacity ? 2 * p->capacity : 64;
+        p->piece = realloc(p->piece, p->capacity * sizeof(Piece));
+        assert(p->piece);
+    }
+    p->piece[p->count].size = size;
+    p->piece[p->count].line = line;
+    p->piece[p->count].length = length;
+    p->count++;
+}
+
+
+// Cut the tree of size n into pieces, in output order: a subtree is kept
+// whole once its output fits in PIECE_SIZE bytes and at least minPieces
+// subtrees have been reached at its depth.
+void piecesSplit (Pieces *p, size_t n, size_t depth, size_t minPieces, LengthMemo *memo){
+    size_t length = treeLength(n, memo);
+    if (n == 1 || (length <= PIECE_SIZE && ((size_t) 1 << depth) >= minPieces)){
+        piecesAdd(p, n, 0, length);
+        return;
+    }
+    piecesSplit(p, n - n/2, depth + 1, minPieces, memo);
+    piecesAdd(p, n, 1, lineLength(n));
+    piecesSplit(p, n/2, depth + 1, minPieces, memo);
+}
+
+
+// one thread's share of a batch: every threads-th piece from first on
+typedef struct renderTask{
+    const Piece *piece;
+    size_t first;
+    size_t last;
+    size_t step;
+    char *buffer;
+    const size_t *offset;
+} RenderTask;
+
+
+void * renderPieces (void *arg){
+    RenderTask *task = arg;
+    for(size_t i = task->first; i < task->last; i += task->step){
+        const Piece *piece = &task->piece[i];
+        Output o = { -1, task->buffer + task->offset[i], 0, piece->length };
+        if (piece->line){
+            outputLine(&o, piece->size);
+        } else {
+            treeRender(&o, piece->size);
+        }
+        assert(o.length == piece->length);
+    }
+    return 0;
+}
+
+
+// Write what treePrint prints for the tree of size n to fd, rendering
+// with the given number of threads.  The output is cut into pieces whose
+// lengths are known in advance, so each piece's place in a batch buffer
+// is known too; the threads fill a batch in parallel, and batches are
+// written in order.  Lines too long for a batch are streamed directly.
+void treeParallel (size_t n, int fd, int threads){
+    LengthMemo memo = { 0 };
+    Pieces p = { 0, 0, 0 };
+    piecesSplit(&p, n, 0, (size_t) threads * PIECES_PER_THREAD, &memo);
+
+    size_t batchPieces = (size_t) threads * PIECES_PER_THREAD;
+    size_t capacity = (batchPieces < MAX_BATCH_PIECES ? batchPieces : MAX_BATCH_PIECES) * PIECE_SIZE;
+    Output batch = { fd, malloc(capacity), 0, capacity };
+    size_t *offset = malloc(p.count * sizeof(size_t));
+    RenderTask *tasks = malloc(threads * sizeof(RenderTask));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    assert(batch.buffer && offset && tasks && ids);
+
+    for(size_t first = 0; first < p.count; ){
+        if (p.piece[first].length > capacity){
+            // only a line near the root can be this long
+            outputFlush(&batch);
+            Output o = { fd, batch.buffer, 0, capacity };
+            outputLine(&o, p.piece[first].size);
+            outputFlush(&o);
+            first++;
+            continue;
+        }
+
+        // lay out as many pieces as fit, then render them
+        size_t last = first;
+        batch.length = 0;
+        while(last < p.count && batch.length + p.piece[last].length <= capacity){
+            offset[last] = batch.length;
+            batch.length += p.piece[last].length;
+            last++;
+        }
+
+        int started = 1;
+        for(int t = 0; t < threads; t++){
+            tasks[t] = (RenderTask) { p.piece, first + t, last, threads, batch.buffer, offset };
+        }
+        for(; started < threads; started++){
+            if (pthread_create(&ids[started], 0, renderPieces, &tasks[started]) != 0){
+                break;
+            }
+        }
+        renderPieces(&tasks[0]);
+        for(int t = started; t < threads; t++){
+            // thread creation failed; render its share here
+            renderPieces(&tasks[t]);
+        }
+        for(int t = 1; t < started; t++){
+            pthread_join(ids[t], 0);
+        }
+
+        outputFlush(&batch);
+        first = last;
+    }
+
+    free(ids);
+    free(tasks);
+    free(offset);
+    free(batch.buffer);
+    free(p.piece);
+}
+
+
+// Parse s as a count from 1 to max, in decimal digits only; returns 0 if
+// s is anything else, including a sign, which strtoull would accept.
+unsigned long long parseCount (const char *s, unsigned long long max){
+    if (s[0] < '0' || s[0] > '9'){
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (errno != 0 || *end != '\0' || n > max){
+        return 0;
+    }
+    return n;
+}
+
+
+int main(int argc, char **argv){
+    // -s streams the output instead of building the tree first, and
+    // -j threads does the same on that many threads
+    int stream = argc == 3 && strcmp(argv[1], "-s") == 0;
+    int parallel = argc == 4 && strcmp(argv[1], "-j") == 0;
+    int threads = parallel ? parseCount(argv[2], MAX_THREADS) : 0;
+    int skip = stream ? 1 : parallel ? 2 : 0;
+    size_t n = argc == 2 + skip ? parseCount(argv[1 + skip], skip ? MAX_STREAM_SIZE : MAX_SIZE) : 0;
+    if (n < 1 || (parallel && threads < 1)){
+        fprintf(stderr, "Usage: ./tree [-s | -j threads] [size]\n");
+        exit(1);
+    }
+
+    if (stream){
+        treeStream(n, STDOUT_FILENO);
+        return 0;
+    } else if (threads){
+        treeParallel(n, STDOUT_FILENO, threads);
+        return 0;
+    }
+    Node *t = treeCreate(n);
+    treePrint(t, 0, n);
+    treeDestroy(t);
+}